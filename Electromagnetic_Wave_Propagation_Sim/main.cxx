@@ -1,59 +1,771 @@
 #include <iostream>
 #include <vector>
 #include <thread>
-#include <mutex>
+#include <atomic>
 #include <chrono>
+#include <string>
+#include <algorithm>
+#include <random>
+#include <limits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+#include <iomanip>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <immintrin.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../common/fdtd_common.hpp"
 
 // Grid size and time step
-const int grid_size = 100; // Size of 2D grid for simulation
+int grid_size = 100;       // Size of 2D grid for simulation (--grid-size, --bench)
 const double dt = 0.01;    // Time step (small for accuracy)
 const double dx = 0.1;     // Grid spacing
 
-// Electric and magnetic fields (2D grid)
-std::vector<std::vector<double>> E(grid_size, std::vector<double>(grid_size, 0.0)); // Electric field
-std::vector<std::vector<double>> B(grid_size, std::vector<double>(grid_size, 0.0)); // Magnetic field
+// Barrier shared by the worker threads of one run (see fdtd_common.hpp)
+using Barrier = BasicBarrier<>;
 
-std::mutex field_mutex; // Mutex to ensure safe multithreading
+// Both half-steps have the form out[j] += coeff * (hi[j] - lo[j]) with
+// coeff = dt / dx folded once per run instead of dividing on every cell.
+// T is the field scalar (double, or float for twice the SIMD lanes).
+template <typename T>
+using DifferenceRowKernel = void (*)(T* out, const T* hi, const T* lo, T coeff, int n);
 
-// Function to update electric field using finite-difference equations
-void update_electric_field(double dt, double dx) {
-    std::lock_guard<std::mutex> guard(field_mutex); // Ensure thread-safe access
-    for (int i = 1; i < grid_size - 1; ++i) {
-        for (int j = 1; j < grid_size - 1; ++j) {
-            // Simplified update equation: change in E depends on B
-            E[i][j] += dt * (B[i+1][j] - B[i][j]) / dx;
+// Scalar reference kernel (also used for vector-loop tails)
+template <typename T>
+void difference_row_scalar(T* out, const T* hi, const T* lo, T coeff, int n) {
+    for (int j = 0; j < n; ++j) {
+        out[j] = out[j] + coeff * (hi[j] - lo[j]);
+    }
+}
+
+// fp-contract=off stops the compiler fusing multiply/add into FMA (which
+// AVX-512 implies), so the vector kernels produce the same bits as the
+// scalar reference.
+__attribute__((target("avx2"), optimize("fp-contract=off")))
+void difference_row_avx2(double* out, const double* hi, const double* lo, double coeff, int n) {
+    const __m256d c = _mm256_set1_pd(coeff);
+    int j = 0;
+    for (; j + 4 <= n; j += 4) {
+        const __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(hi + j), _mm256_loadu_pd(lo + j));
+        _mm256_storeu_pd(out + j, _mm256_add_pd(_mm256_loadu_pd(out + j), _mm256_mul_pd(c, diff)));
+    }
+    difference_row_scalar(out + j, hi + j, lo + j, coeff, n - j);
+}
+
+__attribute__((target("avx2"), optimize("fp-contract=off")))
+void difference_row_avx2(float* out, const float* hi, const float* lo, float coeff, int n) {
+    const __m256 c = _mm256_set1_ps(coeff);
+    int j = 0;
+    for (; j + 8 <= n; j += 8) {
+        const __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(hi + j), _mm256_loadu_ps(lo + j));
+        _mm256_storeu_ps(out + j, _mm256_add_ps(_mm256_loadu_ps(out + j), _mm256_mul_ps(c, diff)));
+    }
+    difference_row_scalar(out + j, hi + j, lo + j, coeff, n - j);
+}
+
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+void difference_row_avx512(double* out, const double* hi, const double* lo, double coeff, int n) {
+    const __m512d c = _mm512_set1_pd(coeff);
+    for (int j = 0; j < n; j += 8) {
+        const __mmask8 m = j + 8 <= n ? __mmask8(0xFF) : __mmask8((1u << (n - j)) - 1);
+        const __m512d diff = _mm512_sub_pd(_mm512_maskz_loadu_pd(m, hi + j), _mm512_maskz_loadu_pd(m, lo + j));
+        _mm512_mask_storeu_pd(out + j, m, _mm512_add_pd(_mm512_maskz_loadu_pd(m, out + j), _mm512_mul_pd(c, diff)));
+    }
+}
+
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+void difference_row_avx512(float* out, const float* hi, const float* lo, float coeff, int n) {
+    const __m512 c = _mm512_set1_ps(coeff);
+    for (int j = 0; j < n; j += 16) {
+        const __mmask16 m = j + 16 <= n ? __mmask16(0xFFFF) : __mmask16((1u << (n - j)) - 1);
+        const __m512 diff = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, hi + j), _mm512_maskz_loadu_ps(m, lo + j));
+        _mm512_mask_storeu_ps(out + j, m, _mm512_add_ps(_mm512_maskz_loadu_ps(m, out + j), _mm512_mul_ps(c, diff)));
+    }
+}
+
+template <typename T>
+DifferenceRowKernel<T> kernel_for(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::avx512: return difference_row_avx512;
+        case KernelIsa::avx2: return difference_row_avx2;
+        default: return difference_row_scalar<T>;
+    }
+}
+
+// Largest ulp difference between `kernel` and the scalar reference on a
+// random row whose odd length exercises the vector tails
+template <typename T>
+std::uint64_t max_kernel_ulp_error(DifferenceRowKernel<T> kernel) {
+    const int n = 37;
+    std::mt19937_64 rng(12345);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    std::vector<T> hi(n), lo(n), expected(n);
+    for (int j = 0; j < n; ++j) {
+        hi[j] = static_cast<T>(dist(rng));
+        lo[j] = static_cast<T>(dist(rng));
+        expected[j] = static_cast<T>(dist(rng));
+    }
+    std::vector<T> actual = expected;
+    const T coeff = static_cast<T>(dt / dx);
+    difference_row_scalar(expected.data(), hi.data(), lo.data(), coeff, n);
+    kernel(actual.data(), hi.data(), lo.data(), coeff, n);
+    std::uint64_t worst = 0;
+    for (int j = 0; j < n; ++j) worst = std::max(worst, ulp_distance(expected[j], actual[j]));
+    return worst;
+}
+
+// Widest verified kernel the CPU supports, up to kernel_isa_cap()
+template <typename T>
+KernelIsa select_kernel_isa() {
+    const KernelIsa cap = kernel_isa_cap();
+    for (KernelIsa isa : {KernelIsa::avx512, KernelIsa::avx2}) {
+        if (static_cast<int>(isa) > static_cast<int>(cap) || !cpu_supports(isa)) continue;
+        if (max_kernel_ulp_error(kernel_for<T>(isa)) <= 1) return isa;
+        std::cerr << "Warning: " << kernel_isa_name(isa) << " kernel failed verification, skipping.\n";
+    }
+    return KernelIsa::scalar;
+}
+
+// ISA of the kernel in use for scalar type T, chosen once per type;
+// the benchmark harness overrides it to time every supported ISA
+template <typename T>
+KernelIsa& active_isa_slot() {
+    static KernelIsa isa = select_kernel_isa<T>();
+    return isa;
+}
+
+template <typename T>
+KernelIsa active_isa() {
+    return active_isa_slot<T>();
+}
+
+template <typename T>
+DifferenceRowKernel<T> difference_row() {
+    return kernel_for<T>(active_isa<T>());
+}
+
+// CPML graded profile along one axis (normalized units, η = ε = 1).
+// Inside the layer a difference D along the axis becomes D / kappa + psi,
+// with psi <- b * psi + a * D carried between steps.
+struct CpmlProfile {
+    std::vector<double> b, a, inv_kappa;
+
+    // Polynomial grading (order 3) over `thickness` cells next to both ends
+    // of the interior [1, n-1)
+    void build(int n, int thickness, double dt, double dx) {
+        const double order = 3.0, kappa_max = 5.0;
+        const double sigma_max = 0.8 * (order + 1.0) / dx;
+        const double alpha_max = 0.05 * sigma_max;
+        b.assign(n, 0.0);
+        a.assign(n, 0.0);
+        inv_kappa.assign(n, 1.0);
+        for (int idx = 1; idx < n - 1; ++idx) {
+            const int depth = std::max(thickness - (idx - 1), thickness - (n - 2 - idx));
+            if (depth <= 0) continue;
+            const double rho = static_cast<double>(depth) / thickness;
+            const double sigma = sigma_max * std::pow(rho, order);
+            const double kappa = 1.0 + (kappa_max - 1.0) * std::pow(rho, order);
+            const double alpha = alpha_max * (1.0 - rho);
+            b[idx] = std::exp(-(sigma / kappa + alpha) * dt);
+            a[idx] = sigma > 0.0 ? sigma * (b[idx] - 1.0) / (kappa * (sigma + kappa * alpha)) : 0.0;
+            inv_kappa[idx] = 1.0 / kappa;
+        }
+    }
+};
+
+// Absorbing boundary layer. The E update differentiates along i, so it
+// needs psi only in the top/bottom row slabs; the B update differentiates
+// along j, so it needs psi only in the left/right column slabs. psi is
+// kept in the field scalar type, the profiles in double.
+template <typename T>
+struct Cpml2D {
+    int thickness = 0;           // 0 disables the layer
+    CpmlProfile along_i, along_j;
+    std::vector<T> psi_e;        // [2*thickness][grid_size]
+    std::vector<T> psi_b;        // [grid_size][2*thickness]
+
+    // Slab index of `idx` within the layer, or -1 outside it
+    int slab(int idx) const {
+        if (idx >= 1 && idx < 1 + thickness) return idx - 1;
+        if (idx >= grid_size - 1 - thickness && idx < grid_size - 1) return idx - (grid_size - 1 - 2 * thickness);
+        return -1;
+    }
+};
+
+// Electric and magnetic fields (2D grid) plus the absorbing layer state,
+// stored in scalar type T
+template <typename T>
+struct WaveState {
+    std::vector<std::vector<T>> E = std::vector<std::vector<T>>(grid_size, std::vector<T>(grid_size, T(0))); // Electric field
+    std::vector<std::vector<T>> B = std::vector<std::vector<T>>(grid_size, std::vector<T>(grid_size, T(0))); // Magnetic field
+    Cpml2D<T> cpml;
+    int completed_steps = 0;  // Steps completed since the fields were initialised
+};
+
+// Enable (thickness > 0) or disable the CPML; resets the auxiliary state
+template <typename T>
+void configure_cpml(WaveState<T>& s, int thickness) {
+    if (thickness < 0 || 2 * thickness > grid_size - 2) {
+        throw std::invalid_argument("CPML thickness must fit inside the grid interior.");
+    }
+    Cpml2D<T>& cpml = s.cpml;
+    cpml = Cpml2D<T>();
+    if (thickness == 0) return;
+    cpml.thickness = thickness;
+    cpml.along_i.build(grid_size, thickness, dt, dx);
+    cpml.along_j.build(grid_size, thickness, dt, dx);
+    cpml.psi_e.assign(static_cast<std::size_t>(2 * thickness) * grid_size, T(0));
+    cpml.psi_b.assign(static_cast<std::size_t>(grid_size) * 2 * thickness, T(0));
+}
+
+// Snapshot file layout: a CheckpointHeader followed by E and B (row by
+// row, grid_size x grid_size scalars each) and the two CPML psi arrays.
+struct CheckpointHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::int32_t grid_size;
+    std::int64_t step;
+    std::int32_t cpml_thickness;
+    std::int32_t scalar_bytes;  // sizeof the field scalar (4 = float, 8 = double)
+    std::uint64_t file_bytes;
+};
+
+constexpr char checkpoint_magic[8] = {'F', 'D', 'T', 'D', '2', 'C', 'K', 'P'};
+constexpr std::uint32_t checkpoint_version = 2;
+
+// Flat copy of everything a restart needs
+template <typename T>
+struct FieldSnapshot {
+    int step = 0;
+    int cpml_thickness = 0;
+    std::vector<T> e, b, psi_e, psi_b;
+
+    // Copy the live state in, reusing this snapshot's storage
+    void capture(const WaveState<T>& s) {
+        step = s.completed_steps;
+        cpml_thickness = s.cpml.thickness;
+        e.resize(static_cast<std::size_t>(grid_size) * grid_size);
+        b.resize(e.size());
+        for (int i = 0; i < grid_size; ++i) {
+            std::copy(s.E[i].begin(), s.E[i].end(), e.begin() + static_cast<std::ptrdiff_t>(i) * grid_size);
+            std::copy(s.B[i].begin(), s.B[i].end(), b.begin() + static_cast<std::ptrdiff_t>(i) * grid_size);
+        }
+        psi_e = s.cpml.psi_e;
+        psi_b = s.cpml.psi_b;
+    }
+};
+// Write a snapshot under a temporary name and rename it into place, so a
+// crash mid-write never leaves a truncated checkpoint behind
+template <typename T>
+void save_checkpoint(const FieldSnapshot<T>& snap, const std::string& path) {
+    CheckpointHeader h{};
+    std::memcpy(h.magic, checkpoint_magic, sizeof(h.magic));
+    h.version = checkpoint_version;
+    h.grid_size = grid_size;
+    h.step = snap.step;
+    h.cpml_thickness = snap.cpml_thickness;
+    h.scalar_bytes = sizeof(T);
+    h.file_bytes = sizeof(h) + (snap.e.size() + snap.b.size() + snap.psi_e.size() + snap.psi_b.size()) * sizeof(T);
+
+    const std::string tmp_path = path + ".tmp";
+    const int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("Cannot create checkpoint " + tmp_path + ": " + std::strerror(errno));
+    auto put = [&](const void* data, std::size_t bytes) {
+        const char* p = static_cast<const char*>(data);
+        while (bytes > 0) {
+            const ssize_t n = write(fd, p, bytes);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) throw std::runtime_error("Cannot write checkpoint " + tmp_path + ": " + std::strerror(errno));
+            p += n;
+            bytes -= static_cast<std::size_t>(n);
+        }
+    };
+    try {
+        put(&h, sizeof(h));
+        for (const std::vector<T>* v : {&snap.e, &snap.b, &snap.psi_e, &snap.psi_b}) {
+            put(v->data(), v->size() * sizeof(T));
+        }
+        if (fsync(fd) != 0) throw std::runtime_error("Cannot flush checkpoint " + tmp_path + ": " + std::strerror(errno));
+    } catch (...) {
+        close(fd);
+        unlink(tmp_path.c_str());
+        throw;
+    }
+    close(fd);
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Cannot rename checkpoint to " + path + ": " + std::strerror(errno));
+    }
+}
+
+// Restore E, B, the CPML state and the step counter from a snapshot.
+// The file is mapped read-only and each row is copied straight from the
+// mapping into the field rows, with no intermediate read buffer. The
+// snapshot must have been written in the same precision T.
+template <typename T>
+void load_checkpoint(WaveState<T>& s, const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open checkpoint " + path + ": " + std::strerror(errno));
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(CheckpointHeader)) {
+        close(fd);
+        throw std::runtime_error("Invalid checkpoint " + path + ": truncated header");
+    }
+    const std::size_t bytes = static_cast<std::size_t>(info.st_size);
+    void* mapped = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) throw std::runtime_error("Cannot map checkpoint " + path + ": " + std::strerror(errno));
+    struct Unmap {
+        void* p;
+        std::size_t n;
+        ~Unmap() { munmap(p, n); }
+    } unmap{mapped, bytes};
+
+    CheckpointHeader h;
+    std::memcpy(&h, mapped, sizeof(h));
+    if (std::memcmp(h.magic, checkpoint_magic, sizeof(h.magic)) != 0 || h.version != checkpoint_version ||
+        h.grid_size != grid_size || h.file_bytes != bytes) {
+        throw std::runtime_error("Invalid checkpoint " + path + ": not a snapshot of this grid");
+    }
+    if (h.scalar_bytes != static_cast<std::int32_t>(sizeof(T))) {
+        throw std::runtime_error("Invalid checkpoint " + path + ": written with a different field precision");
+    }
+    // The rows are copied straight out of the mapping, so the layout the
+    // header describes must account for exactly the bytes in the file
+    const std::uint64_t cells = static_cast<std::uint64_t>(grid_size) * grid_size;
+    if (h.cpml_thickness < 0 || 2 * h.cpml_thickness > grid_size - 2 ||
+        sizeof(h) + (2 * cells + 4 * static_cast<std::uint64_t>(h.cpml_thickness) * grid_size) * sizeof(T) != bytes) {
+        throw std::runtime_error("Invalid checkpoint " + path + ": size does not match its CPML layout");
+    }
+    configure_cpml(s, h.cpml_thickness);
+    const T* p = reinterpret_cast<const T*>(static_cast<const char*>(mapped) + sizeof(h));
+    for (auto* field : {&s.E, &s.B}) {
+        for (auto& row : *field) {
+            std::copy(p, p + grid_size, row.begin());
+            p += grid_size;
         }
     }
+    for (std::vector<T>* psi : {&s.cpml.psi_e, &s.cpml.psi_b}) {
+        std::copy(p, p + psi->size(), psi->begin());
+        p += psi->size();
+    }
+    s.completed_steps = static_cast<int>(h.step);
 }
 
-// Function to update magnetic field using finite-difference equations
-void update_magnetic_field(double dt, double dx) {
-    std::lock_guard<std::mutex> guard(field_mutex); // Ensure thread-safe access
-    for (int i = 1; i < grid_size - 1; ++i) {
+// Periodic checkpointing for run_leapfrog: every `checkpoint_every` steps
+// a snapshot is written to "<checkpoint_prefix>.step<N>.ckpt"
+std::string checkpoint_prefix;
+int checkpoint_every = 0;
+
+// One background writer per precision
+template <typename T>
+CheckpointWriter<FieldSnapshot<T>>& checkpoint_writer() {
+    static CheckpointWriter<FieldSnapshot<T>> writer(save_checkpoint<T>);
+    return writer;
+}
+
+bool checkpoint_due(int step) {
+    return checkpoint_every > 0 && !checkpoint_prefix.empty() && step % checkpoint_every == 0;
+}
+
+// Function to update electric field rows [row_begin, row_end) using finite-difference equations
+template <typename T>
+void update_electric_field(WaveState<T>& s, int row_begin, int row_end, double dt, double dx) {
+    const T coeff = static_cast<T>(dt / dx);
+    const DifferenceRowKernel<T> kernel = difference_row<T>();
+    auto& E = s.E;
+    const auto& B = s.B;
+    Cpml2D<T>& cpml = s.cpml;
+    for (int i = row_begin; i < row_end; ++i) {
+        const int sl = cpml.thickness > 0 ? cpml.slab(i) : -1;
+        if (sl < 0) {
+            // Simplified update equation: change in E depends on B
+            // E[i][j] += dt/dx * (B[i+1][j] - B[i][j])
+            kernel(E[i].data() + 1, B[i+1].data() + 1, B[i].data() + 1, coeff, grid_size - 2);
+            continue;
+        }
+        // Row inside the absorbing layer: stretch the i-difference
+        T* psi = cpml.psi_e.data() + static_cast<std::size_t>(sl) * grid_size;
+        const double b = cpml.along_i.b[i], a = cpml.along_i.a[i], inv_kappa = cpml.along_i.inv_kappa[i];
         for (int j = 1; j < grid_size - 1; ++j) {
-            // Simplified update equation: change in B depends on E
-            B[i][j] += dt * (E[i][j+1] - E[i][j]) / dx;
+            const T d = B[i+1][j] - B[i][j];
+            psi[j] = static_cast<T>(b * psi[j] + a * d);
+            E[i][j] = E[i][j] + coeff * static_cast<T>(d * inv_kappa + psi[j]);
+        }
+    }
+}
+
+// Function to update magnetic field rows [row_begin, row_end) using finite-difference equations
+template <typename T>
+void update_magnetic_field(WaveState<T>& s, int row_begin, int row_end, double dt, double dx) {
+    const T coeff = static_cast<T>(dt / dx);
+    const DifferenceRowKernel<T> kernel = difference_row<T>();
+    auto& B = s.B;
+    const auto& E = s.E;
+    Cpml2D<T>& cpml = s.cpml;
+    const int L = cpml.thickness;
+    for (int i = row_begin; i < row_end; ++i) {
+        // Simplified update equation: change in B depends on E
+        // B[i][j] += dt/dx * (E[i][j+1] - E[i][j]), vectorized outside the layer
+        kernel(B[i].data() + 1 + L, E[i].data() + 2 + L, E[i].data() + 1 + L, coeff, grid_size - 2 - 2 * L);
+        if (L == 0) continue;
+        // Columns inside the absorbing layer: stretch the j-difference
+        T* psi = cpml.psi_b.data() + static_cast<std::size_t>(i) * 2 * L;
+        for (int band_start : {1, grid_size - 1 - L}) {
+            for (int j = band_start; j < band_start + L; ++j) {
+                const int sl = cpml.slab(j);
+                const T d = E[i][j+1] - E[i][j];
+                psi[sl] = static_cast<T>(cpml.along_j.b[j] * psi[sl] + cpml.along_j.a[j] * d);
+                B[i][j] = B[i][j] + coeff * static_cast<T>(d * cpml.along_j.inv_kappa[j] + psi[sl]);
+            }
+        }
+    }
+}
+
+// Number of workers run_leapfrog actually uses: at least one, and no more
+// than there are interior rows to split between them
+int leapfrog_threads(int requested) {
+    return std::max(1, std::min(requested, grid_size - 2));
+}
+
+// Leapfrog time-stepping driver.
+// The interior rows are split into one contiguous block per worker. Every
+// step runs the E half-step on all blocks, waits at the barrier, then runs
+// the B half-step and waits again, so each B update sees the finished E of
+// the same step and the result does not depend on thread scheduling.
+// On steps due for a checkpoint thread 0 stages a snapshot for the
+// background writer while the others wait at one extra barrier.
+// Returns the wall time of each step in seconds.
+template <typename T>
+std::vector<double> run_leapfrog(WaveState<T>& s, int num_steps, int num_threads) {
+    const int interior = grid_size - 2;
+    num_threads = leapfrog_threads(num_threads);
+    Barrier barrier(num_threads);
+    std::vector<double> step_times(num_steps);
+    const int first_step = s.completed_steps;
+
+    auto worker = [&](int thread_id) {
+        const int base = interior / num_threads;
+        const int extra = interior % num_threads;
+        const int row_begin = 1 + thread_id * base + std::min(thread_id, extra);
+        const int row_end = row_begin + base + (thread_id < extra ? 1 : 0);
+
+        for (int step = 0; step < num_steps; ++step) {
+            auto step_start = std::chrono::high_resolution_clock::now();
+            update_electric_field(s, row_begin, row_end, dt, dx);
+            barrier.arrive_and_wait();
+            update_magnetic_field(s, row_begin, row_end, dt, dx);
+            barrier.arrive_and_wait();
+            if (thread_id == 0) {
+                std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - step_start;
+                step_times[step] = elapsed.count();
+            }
+            if (checkpoint_due(first_step + step + 1)) {
+                if (thread_id == 0) {
+                    s.completed_steps = first_step + step + 1;
+                    checkpoint_writer<T>().submit(
+                        checkpoint_prefix + ".step" + std::to_string(s.completed_steps) + ".ckpt",
+                        [&](FieldSnapshot<T>& snapshot) { snapshot.capture(s); });
+                }
+                barrier.arrive_and_wait();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; ++t) {
+        threads.emplace_back(worker, t);
+    }
+    worker(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    s.completed_steps = first_step + num_steps;
+    return step_times;
+}
+
+// Fill E and B with reproducible random values in [-1, 1), drawn in
+// double and rounded to T
+template <typename T>
+void seed_random_fields(WaveState<T>& s, std::uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    for (auto* field : {&s.E, &s.B}) {
+        for (auto& row : *field) {
+            for (T& v : row) v = static_cast<T>(dist(rng));
+        }
+    }
+}
+
+// Run the same random problem in float and double and report how far the
+// float fields drift. Returns false if the largest deviation of E,
+// relative to the largest |E| of the double run, exceeds `tolerance`.
+bool compare_precisions(int num_steps, int num_threads, int pml_thickness, double tolerance) {
+    WaveState<double> reference;
+    WaveState<float> single;
+    seed_random_fields(reference, 21);
+    seed_random_fields(single, 21);
+    configure_cpml(reference, pml_thickness);
+    configure_cpml(single, pml_thickness);
+    run_leapfrog(reference, num_steps, num_threads);
+    run_leapfrog(single, num_steps, num_threads);
+
+    double max_abs = 0.0, max_diff = 0.0, sum_abs_double = 0.0, sum_abs_float = 0.0;
+    for (int i = 0; i < grid_size; ++i) {
+        for (int j = 0; j < grid_size; ++j) {
+            const double e = reference.E[i][j], f = single.E[i][j];
+            max_abs = std::max(max_abs, std::abs(e));
+            max_diff = std::max(max_diff, std::abs(e - f));
+            sum_abs_double += std::abs(e);
+            sum_abs_float += std::abs(f);
+        }
+    }
+    if (!std::isfinite(sum_abs_double)) {
+        std::cout << "Precision regression: the double run diverged after " << num_steps
+                  << " steps, so there is no reference to compare against.\n";
+        return false;
+    }
+    const double field_error = max_abs > 0.0 ? max_diff / max_abs : max_diff;
+    const double sum_error = sum_abs_double > 0.0 ? std::abs(sum_abs_float - sum_abs_double) / sum_abs_double : 0.0;
+    const bool ok = field_error <= tolerance && sum_error <= tolerance;
+    std::cout << "Precision regression, " << num_steps << " steps (tolerance " << tolerance << ")\n"
+              << "  max |E_float - E_double| / max |E_double|: " << field_error << "\n"
+              << "  relative error of sum |E|:                 " << sum_error << "\n"
+              << "  float is " << (ok ? "within tolerance" : "NOT within tolerance") << "\n";
+    return ok;
+}
+
+// Modelled DRAM traffic of a leapfrog step on a grid that does not fit
+// in cache: each half-step reads E and B and writes one of them, 6 field
+// sweeps per step
+double modelled_bytes_per_step(double cells, std::size_t scalar_bytes) {
+    return 6.0 * cells * scalar_bytes;
+}
+
+void print_bench_row(const BenchResult& r) {
+    std::cout << std::setw(8) << r.precision << std::setw(8) << r.isa << std::setw(7) << r.grid
+              << std::setw(5) << r.threads << std::setw(7) << r.steps << std::fixed << std::setprecision(1)
+              << std::setw(11) << r.mcells_per_s() << std::setw(9) << r.gb_per_s()
+              << std::setw(9) << 100.0 * r.stream_ratio() << "%\n"
+              << std::defaultfloat << std::setprecision(6);
+}
+
+// Time every supported ISA of precision T on every grid size. The step
+// time is the sum of run_leapfrog's per-step times, so thread start-up is
+// not counted; each repetition starts from the same random fields.
+template <typename T>
+void bench_precision(const BenchConfig& config, int num_threads, double stream, std::vector<BenchResult>& results) {
+    const KernelIsa selected = active_isa<T>();
+    for (KernelIsa isa : {KernelIsa::scalar, KernelIsa::avx2, KernelIsa::avx512}) {
+        if (static_cast<int>(isa) > static_cast<int>(selected) || max_kernel_ulp_error(kernel_for<T>(isa)) > 1) {
+            continue;
+        }
+        active_isa_slot<T>() = isa;
+        for (int n : config.sizes) {
+            grid_size = n;
+            const double cells = static_cast<double>(n) * n;
+            const int steps = config.steps > 0 ? config.steps : static_cast<int>(std::clamp(1e8 / cells, 4.0, 1000.0));
+            WaveState<T> s;
+            seed_random_fields(s, 5);
+            run_leapfrog(s, 1, num_threads);
+            double best = std::numeric_limits<double>::infinity();
+            for (int r = 0; r < config.reps; ++r) {
+                seed_random_fields(s, 5);
+                const std::vector<double> step_times = run_leapfrog(s, steps, num_threads);
+                double total = 0.0;
+                for (double t : step_times) total += t;
+                best = std::min(best, total);
+            }
+            BenchResult result;
+            result.solver = "leapfrog-2d";
+            result.precision = std::is_same<T, float>::value ? "float" : "double";
+            result.isa = kernel_isa_name(isa);
+            result.dimensions = 2;
+            result.grid = n;
+            result.threads = leapfrog_threads(num_threads);
+            result.steps = steps;
+            result.seconds = best;
+            result.bytes_per_step = modelled_bytes_per_step(cells, sizeof(T));
+            result.stream_bandwidth = stream;
+            print_bench_row(result);
+            results.push_back(result);
         }
     }
+    active_isa_slot<T>() = selected;
+}
+
+// --bench: sweep grid sizes, thread counts, precisions and kernel ISAs,
+// print Mcells/s and GB/s against the STREAM triad bandwidth at each
+// thread count and optionally write the table as JSON
+int run_benchmark(BenchConfig config) {
+    if (config.sizes.empty()) config.sizes = {256, 1024, 4096};
+    if (config.threads.empty()) {
+        const int hardware = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        for (int t = 1; t < hardware; t *= 2) config.threads.push_back(t);
+        config.threads.push_back(hardware);
+    }
+    for (int n : config.sizes) {
+        if (n < 3) throw std::invalid_argument("Benchmark grids need at least 3 cells per side.");
+    }
+    if (config.stream_bytes == 0) config.stream_bytes = default_stream_bytes();
+
+    const int saved_grid_size = grid_size;
+    std::vector<BenchResult> results;
+    for (int threads : config.threads) {
+        const double stream = stream_triad_bandwidth(config.stream_bytes, threads);
+        std::cout << "Threads " << threads << ": STREAM triad " << std::fixed << std::setprecision(1)
+                  << stream / 1e9 << " GB/s (" << (config.stream_bytes >> 20) << " MiB arrays)\n"
+                  << std::defaultfloat << std::setprecision(6)
+                  << std::setw(8) << "prec" << std::setw(8) << "isa" << std::setw(7) << "grid" << std::setw(5)
+                  << "thr" << std::setw(7) << "steps" << std::setw(11) << "Mcells/s" << std::setw(9) << "GB/s"
+                  << std::setw(10) << "STREAM" << "\n";
+        bench_precision<double>(config, threads, stream, results);
+        bench_precision<float>(config, threads, stream, results);
+    }
+    grid_size = saved_grid_size;
+    std::cout << "(STREAM above 100%: the grid is served from cache rather than DRAM)\n";
+    if (!config.output.empty()) {
+        write_bench_json(config.output, "em-wave-2d", config, results);
+        std::cout << "Wrote " << results.size() << " results to " << config.output << "\n";
+    }
+    return 0;
 }
 
-int main() {
+// Step a state of precision T and report timings
+template <typename T>
+int run_simulation(WaveState<T>& s, int num_steps, int num_threads) {
+    std::cout << "Precision: " << (std::is_same<T, float>::value ? "float" : "double")
+              << ", update kernel: " << kernel_isa_name(active_isa<T>()) << "\n";
+    if (s.completed_steps > 0) {
+        // --steps counts from the start of the original run
+        std::cout << "Resuming from step " << s.completed_steps << "\n";
+        num_steps = std::max(0, num_steps - s.completed_steps);
+    }
+
     // Initialize chrono for performance measurement
     auto start_time = std::chrono::high_resolution_clock::now();
 
-    // Threads for updating electric and magnetic fields
-    std::thread electric_thread(update_electric_field, dt, dx);
-    std::thread magnetic_thread(update_magnetic_field, dt, dx);
-
-    // Join threads to ensure both complete before proceeding
-    electric_thread.join();
-    magnetic_thread.join();
+    std::vector<double> step_times = run_leapfrog(s, num_steps, num_threads);
 
     // End time for performance measurement
     auto end_time = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed_time = end_time - start_time;
 
-    std::cout << "Simulation completed in " << elapsed_time.count() << " seconds.\n";
+    if (!step_times.empty()) {
+        double total = 0.0;
+        for (double t : step_times) total += t;
+        std::cout << "Per-step wall time: min " << *std::min_element(step_times.begin(), step_times.end())
+                  << " s, mean " << total / step_times.size()
+                  << " s, max " << *std::max_element(step_times.begin(), step_times.end()) << " s\n";
+    }
+    std::cout << "Simulation of " << num_steps << " steps on " << leapfrog_threads(num_threads)
+              << " threads completed in "
+              << elapsed_time.count() << " seconds.\n";
+    if (checkpoint_every > 0 && !checkpoint_prefix.empty()) {
+        checkpoint_writer<T>().flush();
+        std::cout << "Checkpoints written: " << checkpoint_writer<T>().written()
+                  << " (" << checkpoint_writer<T>().dropped() << " superseded before writing)\n";
+    }
 
     return 0;
 }
+
+// Test programs define FDTD_NO_MAIN and include this file for its API
+#ifndef FDTD_NO_MAIN
+// Bad arguments (and unreadable checkpoints) are reported, not left to
+// abort the program
+int main(int argc, char** argv) try {
+    // Optional knobs: --steps=N, --threads=N, --pml=L (CPML thickness) and --verify-kernels;
+    // --checkpoint=PREFIX --checkpoint-every=N snapshot the run, --restart=FILE resumes one;
+    // --precision=double|float, --compare-precision checks float against double;
+    // --grid-size=N; --bench times every precision and kernel ISA over
+    // --bench-sizes=N,.. and --bench-threads=T,.. (--bench-steps=S, --stream-mb=M)
+    // against STREAM, --bench-output=FILE writes the results as JSON
+    int num_steps = 100;
+    int num_threads = std::max(1u, std::thread::hardware_concurrency());
+    int pml_thickness = 0;
+    std::string restart_path;
+    std::string precision = "double";
+    bool run_precision_check = false;
+    double precision_tolerance = 1e-4;
+    bool run_bench = false;
+    BenchConfig bench;
+    for (int a = 1; a < argc; ++a) {
+        const std::string arg = argv[a];
+        if (arg.rfind("--steps=", 0) == 0) num_steps = std::stoi(arg.substr(8));
+        if (arg.rfind("--threads=", 0) == 0) num_threads = std::stoi(arg.substr(10));
+        if (arg.rfind("--pml=", 0) == 0) pml_thickness = std::stoi(arg.substr(6));
+        if (arg.rfind("--checkpoint=", 0) == 0) {
+            checkpoint_prefix = arg.substr(13);
+            if (checkpoint_every == 0) checkpoint_every = 10;
+        }
+        if (arg.rfind("--checkpoint-every=", 0) == 0) checkpoint_every = std::stoi(arg.substr(19));
+        if (arg.rfind("--restart=", 0) == 0) restart_path = arg.substr(10);
+        if (arg.rfind("--precision=", 0) == 0) precision = arg.substr(12);
+        if (arg == "--compare-precision") run_precision_check = true;
+        if (arg.rfind("--precision-tolerance=", 0) == 0) precision_tolerance = std::stod(arg.substr(22));
+        if (arg.rfind("--grid-size=", 0) == 0) grid_size = std::stoi(arg.substr(12));
+        if (arg == "--bench") run_bench = true;
+        if (arg.rfind("--bench-sizes=", 0) == 0) bench.sizes = parse_positive_list(arg.substr(14), "benchmark sizes");
+        if (arg.rfind("--bench-threads=", 0) == 0) {
+            bench.threads = parse_positive_list(arg.substr(16), "benchmark thread counts");
+        }
+        if (arg.rfind("--bench-steps=", 0) == 0) bench.steps = std::stoi(arg.substr(14));
+        if (arg.rfind("--bench-output=", 0) == 0) bench.output = arg.substr(15);
+        if (arg.rfind("--stream-mb=", 0) == 0) bench.stream_bytes = std::stoul(arg.substr(12)) << 20;
+        if (arg == "--verify-kernels") {
+            // Compare every supported ISA against the scalar reference, in both precisions
+            bool ok = true;
+            for (KernelIsa isa : {KernelIsa::scalar, KernelIsa::avx2, KernelIsa::avx512}) {
+                if (!cpu_supports(isa)) continue;
+                const std::uint64_t ulps = max_kernel_ulp_error(kernel_for<double>(isa));
+                const std::uint64_t ulps_float = max_kernel_ulp_error(kernel_for<float>(isa));
+                std::cout << kernel_isa_name(isa) << ": max error " << ulps << " ulp (double), "
+                          << ulps_float << " ulp (float)\n";
+                ok = ok && ulps <= 1 && ulps_float <= 1;
+            }
+            return ok ? 0 : 1;
+        }
+    }
+    if (grid_size < 3) {
+        throw std::invalid_argument("--grid-size must be at least 3.");
+    }
+    if (num_steps < 0) {
+        throw std::invalid_argument("--steps must not be negative.");
+    }
+    if (run_bench) {
+        return run_benchmark(bench);
+    }
+    if (run_precision_check) {
+        return compare_precisions(num_steps, num_threads, pml_thickness, precision_tolerance) ? 0 : 1;
+    }
+
+    auto run = [&](auto& state) {
+        configure_cpml(state, pml_thickness);
+        if (!restart_path.empty()) load_checkpoint(state, restart_path);
+        return run_simulation(state, num_steps, num_threads);
+    };
+    if (precision == "float") {
+        static WaveState<float> single;
+        return run(single);
+    }
+    if (precision != "double") {
+        throw std::invalid_argument("Unknown precision '" + precision + "' (expected double or float).");
+    }
+    static WaveState<double> state;
+    return run(state);
+} catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return EXIT_FAILURE;
+}
+#endif  // FDTD_NO_MAIN
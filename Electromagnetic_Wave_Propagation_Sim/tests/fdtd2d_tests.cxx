@@ -0,0 +1,116 @@
+// Regression tests for the 2D simulation, run by ctest. main.cxx is a
+// single translation unit, so it is included here with its main() left out.
+#define FDTD_NO_MAIN
+#include "../main.cxx"
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+template <typename T>
+bool same_state(const WaveState<T>& a, const WaveState<T>& b) {
+    return a.E == b.E && a.B == b.B && a.cpml.psi_e == b.cpml.psi_e && a.cpml.psi_b == b.cpml.psi_b &&
+           a.completed_steps == b.completed_steps;
+}
+
+// Every vector kernel the CPU runs stays within 1 ulp of the scalar one
+template <typename T>
+void test_kernels() {
+    for (KernelIsa isa : {KernelIsa::avx2, KernelIsa::avx512}) {
+        if (!cpu_supports(isa)) continue;
+        check(max_kernel_ulp_error(kernel_for<T>(isa)) <= 1,
+              std::string(kernel_isa_name(isa)) + " kernel drifts from the scalar reference");
+    }
+}
+
+// The barrier-synchronised leapfrog gives the same bits on any thread count
+template <typename T>
+void test_thread_counts() {
+    WaveState<T> serial, threaded;
+    for (WaveState<T>* s : {&serial, &threaded}) {
+        configure_cpml(*s, 4);
+        seed_random_fields(*s, 9);
+    }
+    run_leapfrog(serial, 25, 1);
+    run_leapfrog(threaded, 25, 4);
+    check(same_state(serial, threaded), "leapfrog differs between 1 and 4 threads");
+    check(leapfrog_threads(1000) == grid_size - 2 && leapfrog_threads(0) == 1, "worker count clamp");
+}
+
+// A run resumed from a snapshot continues exactly like the original
+template <typename T>
+void test_checkpoint_round_trip(const std::string& dir) {
+    const std::string path = dir + "/round_trip_2d.ckpt";
+    WaveState<T> original;
+    configure_cpml(original, 4);
+    seed_random_fields(original, 11);
+    run_leapfrog(original, 10, 2);
+    FieldSnapshot<T> snapshot;
+    snapshot.capture(original);
+    save_checkpoint(snapshot, path);
+
+    WaveState<T> restored;
+    load_checkpoint(restored, path);
+    check(same_state(original, restored), "restored state differs from the saved one");
+    run_leapfrog(original, 10, 2);
+    run_leapfrog(restored, 10, 2);
+    check(same_state(original, restored), "run resumed from a checkpoint diverges");
+}
+
+bool load_fails(const std::string& path) {
+    WaveState<double> s;
+    try {
+        load_checkpoint(s, path);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+void test_corrupt_checkpoints(const std::string& dir) {
+    const std::string good = dir + "/good_2d.ckpt", bad = dir + "/bad_2d.ckpt";
+    WaveState<double> s;
+    configure_cpml(s, 4);
+    FieldSnapshot<double> snapshot;
+    snapshot.capture(s);
+    save_checkpoint(snapshot, good);
+    std::ifstream in(good, std::ios::binary);
+    const std::string bytes((std::istreambuf_iterator<char>(in)), {});
+
+    auto damaged = [&](std::size_t offset, std::int32_t value) {
+        std::string copy = bytes;
+        std::memcpy(&copy[offset], &value, sizeof value);
+        std::ofstream(bad, std::ios::binary | std::ios::trunc) << copy;
+        return load_fails(bad);
+    };
+    check(damaged(offsetof(CheckpointHeader, cpml_thickness), 10), "CPML thickness not matching the file size");
+    check(damaged(offsetof(CheckpointHeader, cpml_thickness), -1), "negative CPML thickness");
+    check(damaged(offsetof(CheckpointHeader, grid_size), grid_size + 1), "snapshot of another grid");
+    check(damaged(offsetof(CheckpointHeader, scalar_bytes), 4), "snapshot of another precision");
+    std::ofstream(bad, std::ios::binary | std::ios::trunc) << bytes.substr(0, bytes.size() - 8);
+    check(load_fails(bad), "truncated file");
+    check(!load_fails(good), "intact checkpoint loads");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::string dir = argc > 1 ? argv[1] : ".";
+    grid_size = 64;
+    test_kernels<double>();
+    test_kernels<float>();
+    test_thread_counts<double>();
+    test_thread_counts<float>();
+    test_checkpoint_round_trip<double>(dir);
+    test_checkpoint_round_trip<float>(dir);
+    test_corrupt_checkpoints(dir);
+    std::cout << (failures == 0 ? "All 2D simulation tests passed\n" : "2D simulation tests failed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,343 @@
+// Building blocks shared by the FDTD programs in this repository (the 2D
+// wave simulation and the 3D leakage detector): the worker barrier, CPU
+// kernel dispatch helpers, the benchmark harness plumbing (STREAM triad,
+// result records, JSON report) and the background checkpoint writer.
+// Header-only; each program includes it once with a relative path, so no
+// extra include directories are needed.
+#ifndef FDTD_COMMON_HPP
+#define FDTD_COMMON_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <unistd.h>
+
+/**************************************************************
+*                      WORKER BARRIER                         *
+**************************************************************/
+
+// Default WaitScope of BasicBarrier: waits are not instrumented
+struct NoBarrierWaitScope {};
+
+// Reusable barrier for a fixed number of participants.
+// Waiters spin briefly on the generation counter (half-steps are short) and
+// then yield, so oversubscribed machines still make progress. A WaitScope
+// object lives for the duration of every arrive_and_wait(), which lets a
+// program charge barrier waits to its profiler.
+template <typename WaitScope = NoBarrierWaitScope>
+class BasicBarrier {
+public:
+    explicit BasicBarrier(int participants) : participants_(participants) {}
+
+    void arrive_and_wait() {
+        [[maybe_unused]] WaitScope scope{};
+        const unsigned generation = generation_.load(std::memory_order_acquire);
+        if (arrived_.fetch_add(1, std::memory_order_acq_rel) + 1 == participants_) {
+            arrived_.store(0, std::memory_order_relaxed);
+            generation_.fetch_add(1, std::memory_order_release);
+            return;
+        }
+        for (int spins = 0; generation_.load(std::memory_order_acquire) == generation; ++spins) {
+            if (spins > 1024) std::this_thread::yield();
+        }
+    }
+
+private:
+    const int participants_;
+    std::atomic<int> arrived_{0};
+    std::atomic<unsigned> generation_{0};
+};
+
+/**************************************************************
+*                 CPU KERNEL DISPATCH HELPERS                 *
+**************************************************************/
+
+enum class KernelIsa { scalar, avx2, avx512 };
+
+inline const char* kernel_isa_name(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::avx512: return "avx512";
+        case KernelIsa::avx2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+inline bool cpu_supports(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::avx512: return __builtin_cpu_supports("avx512f");
+        case KernelIsa::avx2: return __builtin_cpu_supports("avx2");
+        default: return true;
+    }
+}
+
+// Widest ISA the kernels may use: avx512 unless capped by FDTD_ISA
+// (scalar|avx2|avx512)
+inline KernelIsa kernel_isa_cap() {
+    if (const char* env = std::getenv("FDTD_ISA")) {
+        const std::string wanted = env;
+        if (wanted == "scalar") return KernelIsa::scalar;
+        if (wanted == "avx2") return KernelIsa::avx2;
+    }
+    return KernelIsa::avx512;
+}
+
+// Distance between two values in units in the last place
+inline std::uint64_t ulp_distance(double a, double b) {
+    std::int64_t ia, ib;
+    std::memcpy(&ia, &a, sizeof a);
+    std::memcpy(&ib, &b, sizeof b);
+    if (ia < 0) ia = std::numeric_limits<std::int64_t>::min() - ia;
+    if (ib < 0) ib = std::numeric_limits<std::int64_t>::min() - ib;
+    return ia > ib ? std::uint64_t(ia) - std::uint64_t(ib) : std::uint64_t(ib) - std::uint64_t(ia);
+}
+
+inline std::uint64_t ulp_distance(float a, float b) {
+    std::int32_t ia, ib;
+    std::memcpy(&ia, &a, sizeof a);
+    std::memcpy(&ib, &b, sizeof b);
+    const std::int64_t la = ia < 0 ? std::int64_t(std::numeric_limits<std::int32_t>::min()) - ia : ia;
+    const std::int64_t lb = ib < 0 ? std::int64_t(std::numeric_limits<std::int32_t>::min()) - ib : ib;
+    return static_cast<std::uint64_t>(la > lb ? la - lb : lb - la);
+}
+
+/**************************************************************
+*                BENCHMARK HARNESS PLUMBING                   *
+**************************************************************/
+
+// What --bench sweeps
+struct BenchConfig {
+    std::vector<int> sizes;       // empty: the program's default grid sizes
+    std::vector<int> threads;     // empty: 1, 2, 4, ... and the hardware thread count
+    int steps = 0;                // 0: about 1e8 cell updates per timing
+    int reps = 3;                 // timings per configuration; the best is kept
+    std::size_t stream_bytes = 0; // STREAM array size; 0: 4x the last-level cache, 64-256 MiB
+    std::string output;           // JSON report, empty for the table only
+};
+
+// One timed configuration on a grid of `grid` cells per side in
+// `dimensions` dimensions. bytes_per_step is the modelled DRAM traffic,
+// so gb_per_s is the bandwidth the kernel would need if the grid streams
+// from memory, and stream_ratio how close that comes to the machine's
+// measured STREAM triad bandwidth.
+struct BenchResult {
+    std::string solver;
+    std::string precision;
+    std::string isa;
+    int dimensions = 3;
+    int grid = 0, threads = 0, steps = 0;
+    double seconds = 0.0;
+    double bytes_per_step = 0.0;
+    double stream_bandwidth = 0.0;  // bytes/s at the same thread count
+
+    double mcells_per_s() const { return std::pow(static_cast<double>(grid), dimensions) * steps / seconds / 1e6; }
+    double gb_per_s() const { return bytes_per_step * steps / seconds / 1e9; }
+    double stream_ratio() const { return stream_bandwidth > 0.0 ? gb_per_s() * 1e9 / stream_bandwidth : 0.0; }
+};
+
+// Comma-separated list of positive integers, e.g. "64,128,256"
+inline std::vector<int> parse_positive_list(const std::string& spec, const char* what) {
+    std::string fields_text = spec;
+    std::replace(fields_text.begin(), fields_text.end(), ',', ' ');
+    std::istringstream fields(fields_text);
+    std::vector<int> values;
+    int v;
+    while (fields >> v) {
+        if (v <= 0) throw std::invalid_argument(std::string("Bad ") + what + " '" + spec + "'.");
+        values.push_back(v);
+    }
+    if (values.empty() || !fields.eof()) throw std::invalid_argument(std::string("Bad ") + what + " '" + spec + "'.");
+    return values;
+}
+
+// Last-level cache size in bytes (falls back to 8 MiB when unknown)
+inline std::size_t last_level_cache_bytes() {
+    long bytes = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (bytes <= 0) bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    return bytes > 0 ? static_cast<std::size_t>(bytes) : (8u << 20);
+}
+
+inline std::size_t default_stream_bytes() {
+    return std::min<std::size_t>(std::max<std::size_t>(4 * last_level_cache_bytes(), 64u << 20), 256u << 20);
+}
+
+// Sustainable memory bandwidth in bytes/s: the STREAM triad
+// a[i] = b[i] + s*c[i] on three `array_bytes` arrays with `num_threads`
+// threads, best of `reps`. Each thread first touches the chunk it streams.
+inline double stream_triad_bandwidth(std::size_t array_bytes, int num_threads, int reps = 5) {
+    const std::size_t n = array_bytes / sizeof(double);
+    std::unique_ptr<double[]> a(new double[n]), b(new double[n]), c(new double[n]);
+    BasicBarrier<> barrier(num_threads);
+    double best = std::numeric_limits<double>::infinity();
+
+    auto worker = [&](int thread_id) {
+        const std::size_t begin = n * thread_id / num_threads, end = n * (thread_id + 1) / num_threads;
+        for (std::size_t i = begin; i < end; ++i) {
+            a[i] = 0.0;
+            b[i] = 1.0;
+            c[i] = 2.0;
+        }
+        for (int r = 0; r < reps; ++r) {
+            barrier.arrive_and_wait();
+            const auto start = std::chrono::steady_clock::now();
+            const double s = 3.0;
+            for (std::size_t i = begin; i < end; ++i) a[i] = b[i] + s * c[i];
+            barrier.arrive_and_wait();
+            if (thread_id == 0) {
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                best = std::min(best, elapsed.count());
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; ++t) threads.emplace_back(worker, t);
+    worker(0);
+    for (auto& thread : threads) thread.join();
+    if (a[n / 2] != 7.0) throw std::runtime_error("STREAM triad produced a wrong result.");
+    return 3.0 * static_cast<double>(n) * sizeof(double) / best;
+}
+
+// Machine-readable report: one object per timed configuration, with the
+// context needed to compare runs across releases and machines
+inline void write_bench_json(const std::string& path, const char* program, const BenchConfig& config,
+                             const std::vector<BenchResult>& results) {
+    std::ofstream out(path);
+    if (!out) throw std::runtime_error("Cannot write benchmark report '" + path + "'.");
+    out << std::setprecision(9);
+    out << "{\n  \"schema\": 1,\n  \"program\": \"" << program << "\",\n"
+        << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+        << "  \"last_level_cache_bytes\": " << last_level_cache_bytes() << ",\n"
+        << "  \"stream_array_bytes\": " << config.stream_bytes << ",\n"
+        << "  \"results\": [\n";
+    for (std::size_t r = 0; r < results.size(); ++r) {
+        const BenchResult& b = results[r];
+        out << "    {\"solver\": \"" << b.solver << "\", \"precision\": \"" << b.precision << "\", \"isa\": \""
+            << b.isa << "\", \"grid\": " << b.grid << ", \"threads\": " << b.threads << ", \"steps\": " << b.steps
+            << ", \"seconds\": " << b.seconds << ", \"mcells_per_s\": " << b.mcells_per_s()
+            << ", \"bytes_per_step\": " << b.bytes_per_step << ", \"gb_per_s\": " << b.gb_per_s()
+            << ", \"stream_gb_per_s\": " << b.stream_bandwidth / 1e9 << ", \"stream_ratio\": " << b.stream_ratio()
+            << "}" << (r + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    if (!out) throw std::runtime_error("Failed writing benchmark report '" + path + "'.");
+}
+
+/**************************************************************
+*               BACKGROUND CHECKPOINT WRITER                  *
+**************************************************************/
+
+// Writes snapshots on a background thread. submit() fills a reusable
+// staging Snapshot and returns; the disk write (the save function given
+// at construction) happens while the solver keeps stepping. If a newer
+// snapshot is submitted before the writer has picked up the previous one,
+// the older one is dropped rather than stalling the solver (counted in
+// dropped()). Write errors are rethrown from the next submit() or flush().
+template <typename Snapshot>
+class CheckpointWriter {
+public:
+    using SaveFunction = std::function<void(const Snapshot&, const std::string&)>;
+
+    explicit CheckpointWriter(SaveFunction save) : save_(std::move(save)), thread_([this] { write_loop(); }) {}
+
+    ~CheckpointWriter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        thread_.join();
+    }
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // Queue a snapshot for `path`; capture(Snapshot&) copies the live
+    // state into the staging snapshot, reusing its storage
+    template <typename Capture>
+    void submit(const std::string& path, Capture&& capture) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            rethrow_error();
+            if (pending_) {
+                ++dropped_;
+            } else {
+                pending_ = spare_ ? std::move(spare_) : std::make_unique<Snapshot>();
+            }
+            capture(*pending_);
+            pending_path_ = path;
+        }
+        wake_.notify_all();
+    }
+
+    // Wait until every submitted snapshot is on disk
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return !pending_ && !writing_; });
+        rethrow_error();
+    }
+
+    // Safe to read while the writer runs
+    std::size_t written() const { return written_.load(); }
+    std::size_t dropped() const { return dropped_.load(); }
+
+private:
+    void rethrow_error() {
+        if (error_) {
+            std::exception_ptr error = error_;
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    void write_loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            wake_.wait(lock, [this] { return pending_ || stopping_; });
+            if (!pending_) return;
+            std::unique_ptr<Snapshot> snapshot = std::move(pending_);
+            const std::string path = pending_path_;
+            writing_ = true;
+            lock.unlock();
+            try {
+                save_(*snapshot, path);
+                lock.lock();
+                ++written_;
+            } catch (...) {
+                lock.lock();
+                error_ = std::current_exception();
+            }
+            writing_ = false;
+            spare_ = std::move(snapshot);
+            idle_.notify_all();
+        }
+    }
+
+    const SaveFunction save_;
+    std::mutex mutex_;
+    std::condition_variable wake_, idle_;
+    std::unique_ptr<Snapshot> pending_, spare_;
+    std::string pending_path_;
+    bool writing_ = false, stopping_ = false;
+    std::atomic<std::size_t> written_{0}, dropped_{0};
+    std::exception_ptr error_;
+    std::thread thread_;
+};
+
+#endif  // FDTD_COMMON_HPP
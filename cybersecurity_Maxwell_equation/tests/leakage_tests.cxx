@@ -0,0 +1,220 @@
+// Regression tests for the leakage detector, run by ctest. The solver is a
+// single translation unit, so it is included here with its main() left out.
+// Every check compares results bit for bit: the solver promises identical
+// fields whatever the thread count, tiling or restart point.
+#define FDTD_NO_MAIN
+#include "../FDTD-Based_Electromagnetic_Leakage_Detection_for_Secure_Hardware_Design.cxx"
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+template <typename T>
+bool same_grid(const Grid3D<T>& a, const Grid3D<T>& b) {
+    return a.same_shape(b) && a.capacity() == b.capacity() &&
+           std::memcmp(a.data(), b.data(), a.capacity() * sizeof(T)) == 0;
+}
+
+bool same_fields(const FdtdState& a, const FdtdState& b) {
+    return same_grid(a.electric_field, b.electric_field) && same_grid(a.magnetic_field, b.magnetic_field) &&
+           same_grid(a.current_density, b.current_density) && a.cpml.psi_ex == b.cpml.psi_ex &&
+           a.cpml.psi_hx == b.cpml.psi_hx && a.cpml.psi_ey == b.cpml.psi_ey && a.cpml.psi_hy == b.cpml.psi_hy;
+}
+
+// Random fields, a CPML layer and two shields of different materials
+FdtdState make_state(int n) {
+    FdtdState st;
+    seed_random_state(st, n, 3);
+    configure_cpml(st, 3);
+    apply_shielding(st, 4, 4, 4, 5);
+    apply_shielding(st, n / 2, n / 2, n / 2, 4, 0.7);
+    prepare_run(st);
+    return st;
+}
+
+std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), {});
+}
+
+void write_file(const std::string& path, const std::string& bytes) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+}
+
+bool load_fails(const std::string& path) {
+    try {
+        load_checkpoint(path);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+bool close(double a, double b) {
+    return std::abs(a - b) <= 1e-12 * std::max(std::abs(a), std::abs(b));
+}
+
+void test_thread_counts() {
+    const int saved = fdtd_num_threads;
+    fdtd_num_threads = 1;
+    FdtdState serial = make_state(24);
+    run_slab_steps(serial, 12, false);
+    fdtd_num_threads = 3;
+    FdtdState threaded = make_state(24);
+    run_slab_steps(threaded, 12, false);
+    fdtd_num_threads = saved;
+    check(same_fields(serial, threaded), "slab stepping differs between 1 and 3 threads");
+}
+
+void test_tiling() {
+    FdtdState slab = make_state(24);
+    run_slab_steps(slab, 12, false);
+    FdtdState tiled = make_state(24);
+    TilingConfig tiling;
+    tiling.time_block = 4;
+    run_tiled_steps(tiled, 12, tiling, false);
+    check(same_fields(slab, tiled), "wavefront-tiled stepping differs from slab stepping");
+}
+
+// The metrics streamed from inside the time loop match a separate pass
+// over the shell, on both stepping paths, and the run stops at the first
+// step whose leakage crosses the threshold
+void test_boundary_probes() {
+    FdtdState slab = make_state(24);
+    check(run_slab_steps(slab, 12, false) == 12, "run without a threshold stops early");
+    const LeakageMetrics& m = slab.boundary_probes.metrics;
+    check(m.steps == 12 && m.cells > 0, "probe metrics cover every step");
+    check(close(m.last, analyze_em_leakage(slab)), "streamed leakage differs from analyze_em_leakage");
+
+    FdtdState tiled = make_state(24);
+    TilingConfig tiling;
+    tiling.time_block = 4;
+    run_tiled_steps(tiled, 12, tiling, false);
+    const LeakageMetrics& t = tiled.boundary_probes.metrics;
+    check(t.steps == m.steps && close(t.last, m.last) && close(t.peak, m.peak) && close(t.sum_squares, m.sum_squares),
+          "tiled stepping streams different probe metrics");
+
+    FdtdState stopped = make_state(24);
+    stopped.boundary_probes.stop_threshold = 0.5 * m.last;
+    const int steps_run = run_slab_steps(stopped, 12, false);
+    const int crossed = stopped.boundary_probes.metrics.crossed_at_step;
+    check(crossed >= 0 && steps_run == crossed + 1 && steps_run < 12, "early stop at the threshold crossing");
+}
+
+void test_checkpoint_round_trip(const std::string& dir) {
+    const std::string path = dir + "/round_trip.ckpt";
+    FdtdState st = make_state(24);
+    run_slab_steps(st, 6, false);
+    save_checkpoint(st, st.step, path);
+
+    FdtdState restored = load_checkpoint(path);
+    check(restored.step == st.step, "restored step counter");
+    check(same_fields(st, restored), "restored fields and CPML state");
+    check(same_grid(st.material_map, restored.material_map), "restored material map");
+
+    prepare_run(restored);
+    run_slab_steps(st, 6, false);
+    run_slab_steps(restored, 6, false);
+    check(same_fields(st, restored), "run resumed from a checkpoint diverges");
+}
+
+void test_corrupt_checkpoints(const std::string& dir) {
+    const std::string good = dir + "/good.ckpt", bad = dir + "/bad.ckpt";
+    FdtdState st = make_state(16);
+    save_checkpoint(st, 0, good);
+    const std::string bytes = read_file(good);
+
+    auto corrupt = [&](std::size_t offset, auto value) {
+        std::string damaged = bytes;
+        std::memcpy(&damaged[offset], &value, sizeof value);
+        write_file(bad, damaged);
+        return load_fails(bad);
+    };
+    check(corrupt(offsetof(CheckpointHeader, material_count), std::uint32_t(1000)), "material count above 256");
+    check(corrupt(offsetof(CheckpointHeader, material_count), std::uint32_t(0)), "zero material count");
+    check(corrupt(offsetof(CheckpointHeader, offset_b), std::uint64_t(1) << 40), "field section past the file");
+    check(corrupt(offsetof(CheckpointHeader, offset_table), ~std::uint64_t(0)), "table offset overflow");
+    check(corrupt(offsetof(CheckpointHeader, field_capacity), ~std::uint64_t(0)), "field capacity overflow");
+    check(corrupt(offsetof(CheckpointHeader, nx), std::int32_t(-1)), "negative grid extent");
+    write_file(bad, bytes.substr(0, bytes.size() / 2));
+    check(load_fails(bad), "truncated file");
+    check(!load_fails(good), "intact checkpoint loads");
+}
+
+// A restart with fewer than 10 steps left still reports progress
+void test_short_restart(const std::string& dir) {
+    const std::string path = dir + "/short.ckpt";
+    FdtdState st = make_state(16);
+    run_slab_steps(st, 7, false);
+    save_checkpoint(st, st.step, path);
+    FdtdState restored = load_checkpoint(path);
+    prepare_run(restored);
+    check(run_slab_steps(restored, 3) == 3, "short restarted run");
+}
+
+void test_sweep_runs_every_candidate_in_full() {
+    FdtdState base = make_state(20);
+    // A threshold every step exceeds: the sweep must ignore it
+    base.boundary_probes.stop_threshold = 0.0;
+    const std::vector<ShieldCandidate> candidates{{3, 3, 3, 4, 0.5}, {8, 8, 8, 3, 0.9}, {2, 10, 5, 6, 0.3}};
+    const std::vector<SweepResult> results = run_shielding_sweep(base, candidates, 8);
+    check(results.size() == candidates.size(), "one sweep result per candidate");
+    for (const SweepResult& r : results) {
+        check(r.steps_run == 8 && r.metrics.steps == 8, "sweep candidate stopped early");
+    }
+    for (std::size_t i = 1; i < results.size(); ++i) {
+        check(results[i - 1].metrics.last <= results[i].metrics.last, "sweep ranked by final leakage");
+    }
+}
+
+void test_subgrid_indices() {
+    YeeState st;
+    st.resize(40, 40, 40);
+    const std::size_t first = add_subgrid(st, 4, 4, 4, 10, 10, 10);
+    const std::size_t second = add_subgrid(st, 20, 20, 20, 30, 30, 30);
+    check(first == 0 && second == 1, "add_subgrid returns the block index");
+    check(st.subgrids[first].x0 == 4 && st.subgrids[second].x0 == 20, "subgrid blocks keep their bounds");
+}
+
+// By default a block is coupled one way: the coarse grid evolves exactly
+// as if it were not refined, so the block cannot destabilise it
+void test_one_way_subgrid() {
+    YeeState plain, refined;
+    for (YeeState* st : {&plain, &refined}) {
+        st->resize(24, 24, 24);
+        st->sources.push_back({6, 12, 12, 1.0, 40 * st->dt, 10 * st->dt});
+    }
+    const std::size_t block = add_subgrid(refined, 10, 8, 8, 16, 16, 16);
+    check(refined.subgrids[block].feedback == 0.0, "subgrids default to one-way coupling");
+    prepare_run(plain);
+    prepare_run(refined);
+    run_yee_steps(plain, 120, false);
+    run_yee_steps(refined, 120, false);
+    check(same_grid(plain.ex, refined.ex) && same_grid(plain.ey, refined.ey) && same_grid(plain.ez, refined.ez) &&
+              same_grid(plain.hx, refined.hx) && same_grid(plain.hy, refined.hy) && same_grid(plain.hz, refined.hz),
+          "one-way subgrid leaves the coarse fields untouched");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::string dir = argc > 1 ? argv[1] : ".";
+    test_thread_counts();
+    test_tiling();
+    test_boundary_probes();
+    test_checkpoint_round_trip(dir);
+    test_corrupt_checkpoints(dir);
+    test_short_restart(dir);
+    test_sweep_runs_every_candidate_in_full();
+    test_subgrid_indices();
+    test_one_way_subgrid();
+    std::cout << (failures == 0 ? "All leakage tests passed\n" : "Leakage tests failed\n");
+    return failures == 0 ? 0 : 1;
+}
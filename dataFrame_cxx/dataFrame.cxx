@@ -15,128 +15,3389 @@
 #include <variant>  // For mixed data types
 #include <vector>
 #include <string>
+#include <string_view>
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+#include <optional>
+#include <unordered_map>
+#include <functional>
+#include <charconv>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <Eigen/Dense>  // For matrix operations
 #include <stdexcept>    // For error handling
 
-// Define a variant to hold various data types
-using DataFrameElement = std::variant<int, double, char, std::string>;
+// Define a variant to hold various data types; std::monostate marks a
+// missing value
+using DataFrameElement = std::variant<int, double, char, std::string, std::monostate>;
 
-// Define a column as a vector of variant elements
+// Define a column of cells as a vector of variant elements. This is only
+// the input format of add_column: frames store typed columns (below).
 using DataFrameColumn = std::vector<DataFrameElement>;
 
+/**************************************************************
+*                 TYPED COLUMNAR STORAGE                      *
+**************************************************************/
+
+// Column buffers start on a cache line (and a full SIMD register)
+constexpr std::size_t buffer_alignment = 64;
+
+template <typename T>
+struct AlignedAllocator {
+    using value_type = T;
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(buffer_alignment)));
+    }
+    void deallocate(T* p, std::size_t) { ::operator delete(p, std::align_val_t(buffer_alignment)); }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// Immutable, reference-counted run of bytes. Copies of a column share
+// its buffers; the owner keeps whatever backs the bytes alive.
+class Buffer {
+public:
+    Buffer() = default;
+
+    // Take over a vector without copying it
+    template <typename T>
+    static Buffer adopt(AlignedVector<T>&& values) {
+        auto owner = std::make_shared<AlignedVector<T>>(std::move(values));
+        Buffer b;
+        b.data_ = reinterpret_cast<const std::byte*>(owner->data());
+        b.size_ = owner->size() * sizeof(T);
+        b.owner_ = std::move(owner);
+        return b;
+    }
+
+    // Bytes owned by someone else, kept alive by `owner`
+    static Buffer view(const void* data, std::size_t size, std::shared_ptr<const void> owner) {
+        Buffer b;
+        b.data_ = static_cast<const std::byte*>(data);
+        b.size_ = size;
+        b.owner_ = std::move(owner);
+        return b;
+    }
+
+    const std::byte* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    template <typename T>
+    const T* as() const { return reinterpret_cast<const T*>(data_); }
+
+private:
+    std::shared_ptr<const void> owner_;
+    const std::byte* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// Physical type of a column: 8-byte integers and doubles, single
+// characters, variable-length strings, and dictionary-encoded strings
+// (int32 codes into a table of distinct values)
+enum class ColumnType : std::uint8_t { int64, float64, character, string, dictionary };
+
+const char* column_type_name(ColumnType type) {
+    switch (type) {
+        case ColumnType::int64: return "int64";
+        case ColumnType::float64: return "float64";
+        case ColumnType::character: return "char";
+        case ColumnType::string: return "string";
+        default: return "dictionary";
+    }
+}
+
+template <typename T>
+constexpr ColumnType column_type_of() {
+    static_assert(std::is_same_v<T, std::int64_t> || std::is_same_v<T, double> || std::is_same_v<T, char>,
+                  "Fixed-width columns hold int64_t, double or char.");
+    if constexpr (std::is_same_v<T, std::int64_t>) return ColumnType::int64;
+    else if constexpr (std::is_same_v<T, double>) return ColumnType::float64;
+    else return ColumnType::character;
+}
+
+struct Dictionary;
+
+// One typed column. Fixed-width values sit in one contiguous buffer;
+// strings are a bytes buffer plus size()+1 offsets into it (string i is
+// bytes[offsets[i], offsets[i+1])); dictionary columns are int32 codes
+// into a shared Dictionary. The validity bitmap has bit i set when row i
+// holds a value and is empty when the column has no nulls. Null slots
+// hold 0 (NaN for float64, "" for strings, -1 for codes).
+class Column {
+public:
+    Column() = default;
+
+    ColumnType type() const { return type_; }
+    std::size_t size() const { return size_; }
+    std::size_t null_count() const { return null_count_; }
+    bool is_numeric() const { return type_ == ColumnType::int64 || type_ == ColumnType::float64; }
+
+    bool is_null(std::size_t row) const {
+        return null_count_ > 0 && !((validity_.as<std::uint64_t>()[row / 64] >> (row % 64)) & 1u);
+    }
+
+    // Contiguous values; throws if the column holds another type
+    template <typename T>
+    const T* values() const {
+        if (type_ != column_type_of<T>()) {
+            throw std::invalid_argument(std::string("Column holds ") + column_type_name(type_) + " values, not " +
+                                        column_type_name(column_type_of<T>()) + ".");
+        }
+        return values_.as<T>();
+    }
+
+    // String of a string or dictionary column
+    std::string_view string_at(std::size_t row) const {
+        if (type_ == ColumnType::dictionary) return dictionary_string(row);
+        if (type_ != ColumnType::string) {
+            throw std::invalid_argument(std::string("Column holds ") + column_type_name(type_) + " values, not strings.");
+        }
+        const std::uint64_t* offsets = offsets_.as<std::uint64_t>();
+        const std::uint64_t begin = offsets[row], end = offsets[row + 1];
+        // Mapped column files are only checked here, as rows are read
+        if (begin > end || end > values_.size()) throw std::runtime_error("Column string offsets are corrupt.");
+        return {values_.as<char>() + begin, static_cast<std::size_t>(end - begin)};
+    }
+
+    // Codes and value table of a dictionary column
+    const std::int32_t* codes() const {
+        if (type_ != ColumnType::dictionary) {
+            throw std::invalid_argument(std::string("Column holds ") + column_type_name(type_) + " values, not codes.");
+        }
+        return values_.as<std::int32_t>();
+    }
+    const std::shared_ptr<const Dictionary>& dictionary() const { return dictionary_; }
+
+    // Call f with the value of `row` (int64_t, double, char or
+    // std::string_view) or std::monostate if it is null
+    template <typename F>
+    decltype(auto) visit(std::size_t row, F&& f) const {
+        if (is_null(row)) return f(std::monostate{});
+        switch (type_) {
+            case ColumnType::int64: return f(values_.as<std::int64_t>()[row]);
+            case ColumnType::float64: return f(values_.as<double>()[row]);
+            case ColumnType::character: return f(values_.as<char>()[row]);
+            default: return f(string_at(row));
+        }
+    }
+
+    const Buffer& value_buffer() const { return values_; }
+    const Buffer& offset_buffer() const { return offsets_; }
+    const Buffer& validity_buffer() const { return validity_; }
+
+    // Bytes held by the column's buffers (and its dictionary)
+    std::size_t memory_bytes() const;
+
+    static Column from_elements(const DataFrameColumn& cells);
+
+    // Wrap existing buffers (e.g. slices of a shared block) as a column
+    static Column from_buffers(ColumnType type, std::size_t size, Buffer values, Buffer offsets = {},
+                               Buffer validity = {}, std::size_t null_count = 0) {
+        if (type == ColumnType::dictionary) throw std::invalid_argument("Dictionary columns need their dictionary.");
+        const std::size_t width = type == ColumnType::character ? 1 : 8;
+        const bool fits = type == ColumnType::string
+                              ? offsets.size() >= (size + 1) * sizeof(std::uint64_t)
+                              : values.size() >= size * width;
+        if (!fits || (null_count > 0 && validity.size() < (size + 63) / 64 * sizeof(std::uint64_t))) {
+            throw std::invalid_argument("Column buffers are smaller than the column.");
+        }
+        Column c;
+        c.type_ = type;
+        c.size_ = size;
+        c.null_count_ = null_count;
+        c.values_ = std::move(values);
+        c.offsets_ = std::move(offsets);
+        if (null_count > 0) c.validity_ = std::move(validity);
+        return c;
+    }
+
+    // Wrap int32 codes into `dictionary` (null rows hold -1)
+    static Column from_dictionary(std::size_t size, Buffer codes, std::shared_ptr<const Dictionary> dictionary,
+                                  Buffer validity = {}, std::size_t null_count = 0) {
+        if (!dictionary || codes.size() < size * sizeof(std::int32_t) ||
+            (null_count > 0 && validity.size() < (size + 63) / 64 * sizeof(std::uint64_t))) {
+            throw std::invalid_argument("Dictionary column buffers are smaller than the column.");
+        }
+        Column c;
+        c.type_ = ColumnType::dictionary;
+        c.size_ = size;
+        c.null_count_ = null_count;
+        c.values_ = std::move(codes);
+        c.dictionary_ = std::move(dictionary);
+        if (null_count > 0) c.validity_ = std::move(validity);
+        return c;
+    }
+
+private:
+    friend class ColumnBuilder;
+
+    std::string_view dictionary_string(std::size_t row) const;
+
+    ColumnType type_ = ColumnType::float64;
+    std::size_t size_ = 0;
+    std::size_t null_count_ = 0;
+    Buffer values_, offsets_, validity_;
+    std::shared_ptr<const Dictionary> dictionary_;
+};
+
+// Appends values of one type and hands the buffers to a Column without
+// copying them. The validity bitmap is only allocated once a null is
+// appended.
+class ColumnBuilder {
+public:
+    explicit ColumnBuilder(ColumnType type, std::size_t expected_rows = 0) : type_(type) {
+        if (type_ == ColumnType::dictionary) {
+            throw std::invalid_argument("Dictionary columns are built with encode_dictionary.");
+        }
+        switch (type_) {
+            case ColumnType::int64: ints_.reserve(expected_rows); break;
+            case ColumnType::float64: doubles_.reserve(expected_rows); break;
+            case ColumnType::character: chars_.reserve(expected_rows); break;
+            default:
+                offsets_.reserve(expected_rows + 1);
+                offsets_.push_back(0);
+        }
+    }
+
+    ColumnType type() const { return type_; }
+    std::size_t size() const { return size_; }
+
+    void append_int64(std::int64_t v) {
+        expect(ColumnType::int64);
+        ints_.push_back(v);
+        mark(true);
+    }
+    void append_double(double v) {
+        expect(ColumnType::float64);
+        doubles_.push_back(v);
+        mark(true);
+    }
+    void append_char(char v) {
+        expect(ColumnType::character);
+        chars_.push_back(v);
+        mark(true);
+    }
+    void append_string(std::string_view v) {
+        expect(ColumnType::string);
+        chars_.insert(chars_.end(), v.begin(), v.end());
+        offsets_.push_back(chars_.size());
+        mark(true);
+    }
+    void append_null() {
+        switch (type_) {
+            case ColumnType::int64: ints_.push_back(0); break;
+            case ColumnType::float64: doubles_.push_back(std::numeric_limits<double>::quiet_NaN()); break;
+            case ColumnType::character: chars_.push_back('\0'); break;
+            default: offsets_.push_back(chars_.size());
+        }
+        mark(false);
+    }
+
+    Column finish() {
+        Column c;
+        c.type_ = type_;
+        c.size_ = size_;
+        c.null_count_ = nulls_;
+        switch (type_) {
+            case ColumnType::int64: c.values_ = Buffer::adopt(std::move(ints_)); break;
+            case ColumnType::float64: c.values_ = Buffer::adopt(std::move(doubles_)); break;
+            case ColumnType::character: c.values_ = Buffer::adopt(std::move(chars_)); break;
+            default:
+                c.values_ = Buffer::adopt(std::move(chars_));
+                c.offsets_ = Buffer::adopt(std::move(offsets_));
+        }
+        if (nulls_ > 0) c.validity_ = Buffer::adopt(std::move(validity_));
+        *this = ColumnBuilder(type_);
+        return c;
+    }
+
+private:
+    void expect(ColumnType type) const {
+        if (type != type_) {
+            throw std::invalid_argument(std::string("Cannot append a ") + column_type_name(type) + " value to a " +
+                                        column_type_name(type_) + " column.");
+        }
+    }
+
+    void mark(bool valid) {
+        if (!valid && nulls_ == 0) {
+            // First null: every earlier row was valid
+            validity_.assign((size_ + 64) / 64, ~std::uint64_t(0));
+        }
+        if (nulls_ > 0 || !valid) {
+            if (size_ / 64 >= validity_.size()) validity_.push_back(~std::uint64_t(0));
+            if (!valid) validity_[size_ / 64] &= ~(std::uint64_t(1) << (size_ % 64));
+        }
+        nulls_ += valid ? 0 : 1;
+        ++size_;
+    }
+
+    ColumnType type_;
+    std::size_t size_ = 0, nulls_ = 0;
+    AlignedVector<std::int64_t> ints_;
+    AlignedVector<double> doubles_;
+    AlignedVector<char> chars_;  // char values, or the bytes of a string column
+    AlignedVector<std::uint64_t> offsets_;
+    AlignedVector<std::uint64_t> validity_;
+};
+
+// Build a typed column from variant cells. The type is the one every
+// non-null cell shares, except that ints mixed with doubles widen to
+// float64; an all-null column is float64. Any other mix (numbers with
+// text, or chars with strings) becomes a string column holding each cell
+// as text, numbers in the shortest form that reads back exactly, so mixed
+// columns still load without losing digits.
+Column Column::from_elements(const DataFrameColumn& cells) {
+    bool ints = false, doubles = false, chars = false, strings = false;
+    for (const DataFrameElement& cell : cells) {
+        ints = ints || std::holds_alternative<int>(cell);
+        doubles = doubles || std::holds_alternative<double>(cell);
+        chars = chars || std::holds_alternative<char>(cell);
+        strings = strings || std::holds_alternative<std::string>(cell);
+    }
+    const bool mixed = (ints || doubles) + chars + strings > 1;
+    const ColumnType type = mixed ? ColumnType::string
+                          : chars ? ColumnType::character
+                          : strings ? ColumnType::string
+                          : ints && !doubles ? ColumnType::int64
+                          : ColumnType::float64;
+
+    ColumnBuilder builder(type, cells.size());
+    char text[32];
+    for (const DataFrameElement& cell : cells) {
+        std::visit([&](const auto& val) {
+            using V = std::decay_t<decltype(val)>;
+            if constexpr (std::is_same_v<V, std::monostate>) builder.append_null();
+            else if constexpr (std::is_same_v<V, std::string>) builder.append_string(val);
+            else if constexpr (std::is_same_v<V, char>) {
+                if (mixed) builder.append_string(std::string_view(&val, 1));
+                else builder.append_char(val);
+            }
+            else if (mixed) {
+                // Shortest text that reads back as the same number
+                const std::to_chars_result r = std::to_chars(text, text + sizeof text, val);
+                builder.append_string(std::string_view(text, static_cast<std::size_t>(r.ptr - text)));
+            }
+            else if constexpr (std::is_same_v<V, int>) {
+                if (type == ColumnType::int64) builder.append_int64(val);
+                else builder.append_double(val);
+            }
+            else builder.append_double(val);
+        }, cell);
+    }
+    return builder.finish();
+}
+
+/**************************************************************
+*                 DICTIONARY-ENCODED COLUMNS                  *
+**************************************************************/
+
+// Table of the distinct values of dictionary columns: a string column
+// sorted ascending (so code order is value order), and each value's
+// std::hash, computed once so hashing a row's key is a table lookup
+struct Dictionary {
+    Column values;
+    AlignedVector<std::uint64_t> hashes;
+
+    std::size_t size() const { return values.size(); }
+
+    // Code of a value, if the dictionary holds it
+    std::optional<std::int32_t> code_of(std::string_view value) const {
+        std::size_t lo = 0, hi = values.size();
+        while (lo < hi) {
+            const std::size_t mid = (lo + hi) / 2;
+            if (values.string_at(mid) < value) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo < values.size() && values.string_at(lo) == value) return static_cast<std::int32_t>(lo);
+        return std::nullopt;
+    }
+};
+
+std::string_view Column::dictionary_string(std::size_t row) const {
+    const std::int32_t code = values_.as<std::int32_t>()[row];
+    // Mapped column files are only checked here, as rows are read
+    if (code < 0 || static_cast<std::size_t>(code) >= dictionary_->size()) {
+        throw std::runtime_error("Column dictionary codes are corrupt.");
+    }
+    return dictionary_->values.string_at(static_cast<std::size_t>(code));
+}
+
+std::size_t Column::memory_bytes() const {
+    std::size_t bytes = values_.size() + offsets_.size() + validity_.size();
+    if (dictionary_) bytes += dictionary_->values.memory_bytes() + dictionary_->hashes.size() * sizeof(std::uint64_t);
+    return bytes;
+}
+
+// Dictionary-encode a string or char column: each row becomes the int32
+// code of its value in a sorted table of the distinct values. Nulls stay
+// null (and share the input's validity bitmap).
+Column encode_dictionary(const Column& column) {
+    if (column.type() == ColumnType::dictionary) return column;
+    if (column.type() != ColumnType::string && column.type() != ColumnType::character) {
+        throw std::invalid_argument(std::string("Only string and char columns are dictionary-encoded, not ") +
+                                    column_type_name(column.type()) + ".");
+    }
+    const std::size_t n = column.size();
+    const auto text = [&](std::size_t row) {
+        return column.type() == ColumnType::string ? column.string_at(row)
+                                                   : std::string_view(column.values<char>() + row, 1);
+    };
+
+    // Codes in order of first appearance, then renumbered in value order
+    std::unordered_map<std::string_view, std::int32_t> seen;
+    std::vector<std::string_view> distinct;
+    AlignedVector<std::int32_t> codes(n);
+    for (std::size_t row = 0; row < n; ++row) {
+        if (column.is_null(row)) {
+            codes[row] = -1;
+            continue;
+        }
+        const auto [it, inserted] = seen.emplace(text(row), static_cast<std::int32_t>(distinct.size()));
+        if (inserted) {
+            if (distinct.size() == static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max())) {
+                throw std::length_error("Too many distinct values for a dictionary column.");
+            }
+            distinct.push_back(it->first);
+        }
+        codes[row] = it->second;
+    }
+    std::vector<std::int32_t> order(distinct.size()), renumber(distinct.size());
+    for (std::size_t i = 0; i < order.size(); ++i) order[i] = static_cast<std::int32_t>(i);
+    std::sort(order.begin(), order.end(), [&](std::int32_t a, std::int32_t b) { return distinct[a] < distinct[b]; });
+
+    auto dictionary = std::make_shared<Dictionary>();
+    ColumnBuilder values(ColumnType::string, distinct.size());
+    dictionary->hashes.resize(distinct.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        renumber[order[i]] = static_cast<std::int32_t>(i);
+        values.append_string(distinct[order[i]]);
+        dictionary->hashes[i] = std::hash<std::string_view>()(distinct[order[i]]);
+    }
+    dictionary->values = values.finish();
+    for (std::int32_t& code : codes) {
+        if (code >= 0) code = renumber[code];
+    }
+    return Column::from_dictionary(n, Buffer::adopt(std::move(codes)), std::move(dictionary), column.validity_buffer(),
+                                   column.null_count());
+}
+
+// Expand a dictionary column back into a string column
+Column decode_dictionary(const Column& column) {
+    ColumnBuilder builder(ColumnType::string, column.size());
+    for (std::size_t row = 0; row < column.size(); ++row) {
+        if (column.is_null(row)) builder.append_null();
+        else builder.append_string(column.string_at(row));
+    }
+    return builder.finish();
+}
+
+/**************************************************************
+*                    DATAFRAME AND PRINTING                   *
+**************************************************************/
+
+class Expr;
+
 // Define the DataFrame as a structure with columns and column names
 struct DataFrame {
-    std::vector<DataFrameColumn> columns;
+    std::vector<Column> columns;
     std::vector<std::string> column_names;
+
+    std::size_t row_count() const { return columns.empty() ? 0 : columns[0].size(); }
+
+    // Lazy expression over the named column (see LAZY COLUMN EXPRESSIONS)
+    Expr operator[](const std::string& name) const;
+};
+
+// Index of the named column; throws if there is none
+std::size_t column_index(const DataFrame& df, const std::string& name) {
+    const auto it = std::find(df.column_names.begin(), df.column_names.end(), name);
+    if (it == df.column_names.end()) throw std::out_of_range("No column named '" + name + "'.");
+    return static_cast<std::size_t>(it - df.column_names.begin());
+}
+
+// Function to add a typed column to the DataFrame
+void add_column(DataFrame& df, const std::string& name, Column column) {
+    // Ensure all columns have the same row count
+    if (!df.columns.empty() && df.row_count() != column.size()) {
+        throw std::invalid_argument("Column size does not match existing DataFrame row count.");
+    }
+    df.column_names.push_back(name);
+    df.columns.push_back(std::move(column));
+}
+
+// Function to add a column of variant cells to the DataFrame (stored typed)
+void add_column(DataFrame& df, const std::string& name, const DataFrameColumn& column) {
+    add_column(df, name, Column::from_elements(column));
+}
+
+// Add string or char cells as a dictionary-encoded (categorical) column
+void add_categorical_column(DataFrame& df, const std::string& name, const DataFrameColumn& column) {
+    add_column(df, name, encode_dictionary(Column::from_elements(column)));
+}
+
+// Function to print the contents of the DataFrame
+void print_dataframe(const DataFrame& df) {
+    // Print column names
+    for (const auto& name : df.column_names) {
+        std::cout << name << "\t";
+    }
+    std::cout << std::endl;
+
+    // Check if DataFrame is empty
+    if (df.columns.empty()) {
+        std::cout << "DataFrame is empty!" << std::endl;
+        return;
+    }
+
+    // Print each row of the DataFrame; nulls print as NA
+    size_t row_count = df.row_count();
+    for (size_t i = 0; i < row_count; ++i) {
+        for (const auto& column : df.columns) {
+            column.visit(i, [](auto&& val) {
+                if constexpr (std::is_same_v<std::decay_t<decltype(val)>, std::monostate>) std::cout << "NA\t";
+                else std::cout << val << "\t";
+            });
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Bytes held by all columns of the DataFrame
+std::size_t memory_bytes(const DataFrame& df) {
+    std::size_t bytes = 0;
+    for (const auto& column : df.columns) bytes += column.memory_bytes();
+    return bytes;
+}
+
+/**************************************************************
+*        ZERO-COPY EIGEN VIEWS OVER NUMERIC COLUMNS           *
+**************************************************************/
+
+using DoubleColumnView = Eigen::Map<const Eigen::VectorXd>;
+using Int64ColumnView = Eigen::Map<const Eigen::Matrix<std::int64_t, Eigen::Dynamic, 1>>;
+// Adjacent float64 columns seen as one column-major matrix; the outer
+// stride is the distance between the starts of neighbouring columns
+using NumericBlockView = Eigen::Map<const Eigen::MatrixXd, Eigen::Unaligned, Eigen::OuterStride<>>;
+
+// Utility function to verify if a column contains only numeric values
+bool is_numeric_column(const Column& column) {
+    return column.is_numeric();
+}
+
+// View a float64 column's buffer in place
+DoubleColumnView double_view(const Column& column) {
+    return DoubleColumnView(column.values<double>(), static_cast<Eigen::Index>(column.size()));
+}
+
+// View an int64 column's buffer in place (null cells read as 0)
+Int64ColumnView int64_view(const Column& column) {
+    return Int64ColumnView(column.values<std::int64_t>(), static_cast<Eigen::Index>(column.size()));
+}
+
+// Call f with a double-valued Eigen expression over a numeric column:
+// the buffer itself for float64, a lazily cast view for int64. Nothing
+// is copied, except that int64 columns with nulls are extracted so the
+// nulls read as NaN (as they do in float64 columns).
+Eigen::VectorXd extract_numeric_column(const Column& column);
+
+template <typename F>
+decltype(auto) with_numeric_view(const Column& column, F&& f) {
+    if (column.type() == ColumnType::float64) return f(double_view(column));
+    if (column.type() != ColumnType::int64) {
+        throw std::invalid_argument("Column contains non-numeric values, cannot extract as numeric.");
+    }
+    if (column.null_count() > 0) {
+        const Eigen::VectorXd values = extract_numeric_column(column);
+        return f(DoubleColumnView(values.data(), values.size()));
+    }
+    return f(int64_view(column).cast<double>());
+}
+
+// The given columns as one matrix view, if they are all float64 without
+// nulls and laid out at a constant, positive distance in memory (as
+// add_numeric_block and pack_numeric_columns arrange them)
+std::optional<NumericBlockView> numeric_block_view(const DataFrame& df, const std::vector<std::size_t>& indices) {
+    if (indices.empty()) return std::nullopt;
+    for (std::size_t c : indices) {
+        if (df.columns.at(c).type() != ColumnType::float64 || df.columns[c].null_count() > 0) return std::nullopt;
+    }
+    const double* first = df.columns[indices[0]].values<double>();
+    const std::ptrdiff_t rows = static_cast<std::ptrdiff_t>(df.row_count());
+    std::ptrdiff_t stride = rows;
+    if (indices.size() > 1) stride = df.columns[indices[1]].values<double>() - first;
+    if (stride < rows) return std::nullopt;
+    for (std::size_t n = 1; n < indices.size(); ++n) {
+        if (df.columns[indices[n]].values<double>() != first + static_cast<std::ptrdiff_t>(n) * stride) {
+            return std::nullopt;
+        }
+    }
+    return NumericBlockView(first, rows, static_cast<Eigen::Index>(indices.size()), Eigen::OuterStride<>(stride));
+}
+
+// Indices of the numeric columns, in order
+std::vector<std::size_t> numeric_column_indices(const DataFrame& df) {
+    std::vector<std::size_t> indices;
+    for (std::size_t c = 0; c < df.columns.size(); ++c) {
+        if (is_numeric_column(df.columns[c])) indices.push_back(c);
+    }
+    return indices;
+}
+
+// float64 columns sharing one allocation, each starting on a 64-byte
+// boundary; fill(c, out) writes column c's `rows` values
+template <typename Fill>
+std::vector<Column> make_block_columns(std::size_t rows, std::size_t count, Fill&& fill) {
+    const std::size_t stride = (rows + buffer_alignment / sizeof(double) - 1) / (buffer_alignment / sizeof(double)) *
+                               (buffer_alignment / sizeof(double));
+    auto block = std::make_shared<AlignedVector<double>>(stride * count);
+    std::vector<Column> columns;
+    for (std::size_t c = 0; c < count; ++c) {
+        double* out = block->data() + c * stride;
+        fill(c, out);
+        columns.push_back(Column::from_buffers(ColumnType::float64, rows,
+                                               Buffer::view(out, rows * sizeof(double), block)));
+    }
+    return columns;
+}
+
+// Add the columns of `values` as adjacent float64 columns, so
+// numeric_block_view sees them as one matrix
+void add_numeric_block(DataFrame& df, const std::vector<std::string>& names,
+                       const Eigen::Ref<const Eigen::MatrixXd>& values) {
+    if (static_cast<Eigen::Index>(names.size()) != values.cols()) {
+        throw std::invalid_argument("Need one name per block column.");
+    }
+    const std::size_t rows = static_cast<std::size_t>(values.rows());
+    std::vector<Column> columns = make_block_columns(rows, names.size(), [&](std::size_t c, double* out) {
+        Eigen::Map<Eigen::VectorXd>(out, values.rows()) = values.col(static_cast<Eigen::Index>(c));
+    });
+    for (std::size_t c = 0; c < columns.size(); ++c) add_column(df, names[c], std::move(columns[c]));
+}
+
+// Copy every float64 column without nulls into one shared block (once),
+// so later numeric operations on the frame can use a single block view
+void pack_numeric_columns(DataFrame& df) {
+    std::vector<std::size_t> indices;
+    for (std::size_t c = 0; c < df.columns.size(); ++c) {
+        if (df.columns[c].type() == ColumnType::float64 && df.columns[c].null_count() == 0) indices.push_back(c);
+    }
+    if (indices.empty() || numeric_block_view(df, indices)) return;
+    std::vector<Column> packed = make_block_columns(df.row_count(), indices.size(), [&](std::size_t n, double* out) {
+        const Column& column = df.columns[indices[n]];
+        std::copy(column.values<double>(), column.values<double>() + column.size(), out);
+    });
+    for (std::size_t n = 0; n < indices.size(); ++n) df.columns[indices[n]] = std::move(packed[n]);
+}
+
+/**************************************************************
+*        EXTRACTING NUMERIC DATA FOR EIGEN OPERATIONS         *
+**************************************************************/
+
+// Extract numeric data (int64 or double) from a column to an owning Eigen
+// vector; null cells become NaN. Prefer the views above when a copy is
+// not needed.
+Eigen::VectorXd extract_numeric_column(const Column& column) {
+    if (!is_numeric_column(column)) {
+        throw std::invalid_argument("Column contains non-numeric values, cannot extract as numeric.");
+    }
+    if (column.type() == ColumnType::float64) return double_view(column);
+
+    Eigen::VectorXd result = int64_view(column).cast<double>();
+    for (size_t i = 0; i < column.size() && column.null_count() > 0; ++i) {
+        if (column.is_null(i)) result[i] = std::numeric_limits<double>::quiet_NaN();
+    }
+    return result;
+}
+
+// Combine numeric columns into a single Eigen matrix, reading each
+// column buffer once
+Eigen::MatrixXd build_numeric_matrix(const DataFrame& df) {
+    const std::vector<std::size_t> indices = numeric_column_indices(df);
+    if (indices.empty()) {
+        throw std::runtime_error("No numeric columns found in DataFrame.");
+    }
+    if (auto block = numeric_block_view(df, indices)) return *block;
+
+    Eigen::MatrixXd matrix(df.row_count(), indices.size());
+    for (size_t i = 0; i < indices.size(); ++i) {
+        with_numeric_view(df.columns[indices[i]], [&](const auto& column) { matrix.col(i) = column; });
+    }
+    return matrix;
+}
+
+// Function to perform element-wise multiplication on numeric columns.
+// Both operands are read in place (as one block each when their columns
+// are adjacent); the result is the only allocation.
+Eigen::MatrixXd elementwise_multiply(const DataFrame& df1, const DataFrame& df2) {
+    const std::vector<std::size_t> indices1 = numeric_column_indices(df1);
+    const std::vector<std::size_t> indices2 = numeric_column_indices(df2);
+    if (indices1.empty() || indices2.empty()) {
+        throw std::runtime_error("No numeric columns found in DataFrame.");
+    }
+    if (df1.row_count() != df2.row_count() || indices1.size() != indices2.size()) {
+        throw std::invalid_argument("Matrices must have the same dimensions for element-wise multiplication.");
+    }
+
+    const auto block1 = numeric_block_view(df1, indices1);
+    const auto block2 = numeric_block_view(df2, indices2);
+    if (block1 && block2) return block1->array() * block2->array();
+
+    Eigen::MatrixXd result(df1.row_count(), indices1.size());
+    for (size_t i = 0; i < indices1.size(); ++i) {
+        with_numeric_view(df1.columns[indices1[i]], [&](const auto& a) {
+            with_numeric_view(df2.columns[indices2[i]], [&](const auto& b) {
+                result.col(i) = a.array() * b.array();
+            });
+        });
+    }
+    return result;
+}
+
+/**************************************************************
+*                    THREADING HELPERS                        *
+**************************************************************/
+
+// Worker threads to use when an option asks for 0 (= all hardware threads)
+unsigned resolve_threads(unsigned threads) {
+    return threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Run f(task, worker) for task = 0 .. tasks-1 on up to `threads` threads,
+// each pulling the next task from a shared counter. The first exception
+// thrown by any task is rethrown on the caller once all threads stop.
+template <typename F>
+void parallel_for(std::size_t tasks, unsigned threads, F&& f) {
+    const unsigned workers = static_cast<unsigned>(std::min<std::size_t>(resolve_threads(threads), tasks));
+    std::atomic<std::size_t> next{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto run = [&](unsigned worker) {
+        for (std::size_t task; (task = next.fetch_add(1)) < tasks;) {
+            try {
+                f(task, worker);
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(error_mutex);
+                if (!error) error = std::current_exception();
+                next = tasks;
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned w = 1; w < workers; ++w) pool.emplace_back(run, w);
+    if (workers > 0) run(0);
+    for (auto& t : pool) t.join();
+    if (error) std::rethrow_exception(error);
+}
+
+/**************************************************************
+*              CSV INGESTION (MMAP, PARALLEL PARSE)           *
+**************************************************************/
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            throw std::runtime_error("Cannot stat " + path + ": " + std::strerror(errno));
+        }
+        size_ = static_cast<std::size_t>(info.st_size);
+        if (size_ > 0) {
+            void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Cannot map " + path + ": " + std::strerror(errno));
+            }
+            data_ = static_cast<const char*>(p);
+        }
+        close(fd);
+    }
+    ~MappedFile() {
+        if (data_) munmap(const_cast<char*>(data_), size_);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+    // Hint the kernel about the access pattern of [offset, offset + bytes)
+    void advise(std::size_t offset, std::size_t bytes, int advice) const {
+        const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        const std::size_t begin = offset / page * page;
+        if (data_ && bytes > 0) madvise(const_cast<char*>(data_) + begin, offset + bytes - begin, advice);
+    }
+
+    // Release the pages wholly inside [offset, offset + bytes) already read
+    void release(std::size_t offset, std::size_t bytes) const {
+        const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        const std::size_t begin = (offset + page - 1) / page * page, end = (offset + bytes) / page * page;
+        if (data_ && end > begin) madvise(const_cast<char*>(data_) + begin, end - begin, MADV_DONTNEED);
+    }
+
+private:
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+struct CsvOptions {
+    char delimiter = ',';
+    bool header = true;           // first line holds the column names
+    unsigned threads = 0;         // 0: one per hardware thread
+    std::size_t batch_bytes = 0;  // CsvReader batch size; 0 reads the file as one batch
+    bool categorical = false;     // dictionary-encode string columns with repeated values
+};
+
+// One field of a line. Quoted fields are stored without their quotes;
+// `escaped` means the text still holds doubled quotes ("") to collapse.
+struct CsvField {
+    std::string_view text;
+    bool escaped = false;
+
+    std::size_t unescaped_size() const {
+        if (!escaped) return text.size();
+        return text.size() - static_cast<std::size_t>(std::count(text.begin(), text.end(), '"')) / 2;
+    }
+
+    void copy_to(char* out) const {
+        if (!escaped) {
+            std::memcpy(out, text.data(), text.size());
+            return;
+        }
+        for (std::size_t i = 0; i < text.size(); ++i) {
+            *out++ = text[i];
+            if (text[i] == '"') ++i;
+        }
+    }
+};
+
+// Split one line (without its newline) into fields. Quoted fields may
+// hold delimiters and "" but not line breaks, because chunks are split
+// on every newline.
+void split_csv_line(std::string_view line, char delimiter, std::vector<CsvField>& fields) {
+    fields.clear();
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    std::size_t pos = 0;
+    while (true) {
+        CsvField field;
+        if (pos < line.size() && line[pos] == '"') {
+            std::size_t close = pos + 1;
+            while (true) {
+                close = line.find('"', close);
+                if (close == std::string_view::npos) throw std::runtime_error("Unterminated quoted CSV field.");
+                if (close + 1 < line.size() && line[close + 1] == '"') {
+                    field.escaped = true;
+                    close += 2;
+                    continue;
+                }
+                break;
+            }
+            field.text = line.substr(pos + 1, close - pos - 1);
+            pos = close + 1;
+            if (pos < line.size() && line[pos] != delimiter) throw std::runtime_error("Text after a quoted CSV field.");
+        } else {
+            const std::size_t end = std::min(line.find(delimiter, pos), line.size());
+            field.text = line.substr(pos, end - pos);
+            pos = end;
+        }
+        fields.push_back(field);
+        if (pos >= line.size()) break;
+        ++pos;  // skip the delimiter
+    }
+}
+
+// What a column's fields look like so far. Kinds only widen: int64 and
+// float64 merge to float64, any other mix of kinds to string.
+enum class CsvKind : std::uint8_t { empty, int64, float64, character, string };
+
+CsvKind merge_kinds(CsvKind a, CsvKind b) {
+    if (a == CsvKind::empty || a == b) return b;
+    if (b == CsvKind::empty) return a;
+    const bool numeric_a = a == CsvKind::int64 || a == CsvKind::float64;
+    const bool numeric_b = b == CsvKind::int64 || b == CsvKind::float64;
+    return numeric_a && numeric_b ? CsvKind::float64 : CsvKind::string;
+}
+
+// Kind of one field; empty fields are nulls
+CsvKind classify_field(const CsvField& field) {
+    const std::string_view t = field.text;
+    if (t.empty()) return CsvKind::empty;
+    if (!field.escaped) {
+        const char* end = t.data() + t.size();
+        std::int64_t i;
+        auto r = std::from_chars(t.data(), end, i);
+        if (r.ec == std::errc() && r.ptr == end) return CsvKind::int64;
+        double d;
+        r = std::from_chars(t.data(), end, d);
+        if (r.ec == std::errc() && r.ptr == end) return CsvKind::float64;
+    }
+    return field.unescaped_size() == 1 ? CsvKind::character : CsvKind::string;
+}
+
+ColumnType csv_column_type(CsvKind kind) {
+    switch (kind) {
+        case CsvKind::int64: return ColumnType::int64;
+        case CsvKind::character: return ColumnType::character;
+        case CsvKind::string: return ColumnType::string;
+        default: return ColumnType::float64;  // float64, or all null
+    }
+}
+
+// Call f(line) for every non-blank line in [begin, end)
+template <typename F>
+void for_each_csv_line(const char* begin, const char* end, F&& f) {
+    while (begin < end) {
+        const char* newline = static_cast<const char*>(std::memchr(begin, '\n', static_cast<std::size_t>(end - begin)));
+        const char* line_end = newline ? newline : end;
+        std::string_view line(begin, static_cast<std::size_t>(line_end - begin));
+        if (!line.empty() && line != "\r") f(line);
+        begin = newline ? newline + 1 : end;
+    }
+}
+
+// Start of the line after the one holding p (or end)
+const char* next_line(const char* p, const char* end) {
+    const char* newline = static_cast<const char*>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+    return newline ? newline + 1 : end;
+}
+
+// Parse the complete lines in [begin, end) into typed columns. The
+// region is cut into chunks on newline boundaries, and chunks are parsed
+// in parallel twice. The first pass counts rows, finds each column's
+// kind and sizes the string bytes. The second pass converts the fields
+// with std::from_chars straight into the final column buffers, at
+// offsets given by the first. `schema` holds the kinds seen so far; it
+// is widened, never narrowed.
+DataFrame parse_csv_region(const char* begin, const char* end, const std::vector<std::string>& names,
+                           std::vector<CsvKind>& schema, const CsvOptions& options) {
+    const std::size_t columns = names.size();
+    const unsigned threads = resolve_threads(options.threads);
+    const std::size_t bytes = static_cast<std::size_t>(end - begin);
+    const std::size_t chunk_count = std::max<std::size_t>(1, std::min<std::size_t>(threads * 4, bytes / (1 << 16)));
+
+    struct Chunk {
+        const char* begin;
+        const char* end;
+        std::size_t rows = 0;
+        std::vector<CsvKind> kinds;
+        std::vector<std::size_t> text_bytes;  // unescaped bytes per column
+        std::size_t bad_row = 0, bad_fields = 0;  // first row with the wrong field count (1-based)
+        std::vector<std::vector<std::size_t>> null_rows;
+    };
+    std::vector<Chunk> chunks(chunk_count);
+    const char* cut = begin;
+    for (std::size_t c = 0; c < chunk_count; ++c) {
+        chunks[c].begin = cut;
+        cut = c + 1 == chunk_count ? end : std::max(cut, next_line(begin + bytes * (c + 1) / chunk_count - 1, end));
+        chunks[c].end = cut;
+    }
+
+    // Pass 1: rows, kinds and string sizes per chunk
+    parallel_for(chunk_count, threads, [&](std::size_t c, unsigned) {
+        Chunk& chunk = chunks[c];
+        chunk.kinds.assign(columns, CsvKind::empty);
+        chunk.text_bytes.assign(columns, 0);
+        std::vector<CsvField> fields;
+        for_each_csv_line(chunk.begin, chunk.end, [&](std::string_view line) {
+            split_csv_line(line, options.delimiter, fields);
+            ++chunk.rows;
+            if (fields.size() != columns) {
+                if (chunk.bad_row == 0) {
+                    chunk.bad_row = chunk.rows;
+                    chunk.bad_fields = fields.size();
+                }
+                return;
+            }
+            for (std::size_t f = 0; f < columns; ++f) {
+                chunk.kinds[f] = merge_kinds(chunk.kinds[f], classify_field(fields[f]));
+                chunk.text_bytes[f] += fields[f].unescaped_size();
+            }
+        });
+    });
+
+    std::size_t rows = 0;
+    std::vector<std::size_t> row_offset(chunk_count), text_offset(chunk_count * columns);
+    std::vector<std::size_t> total_text(columns, 0);
+    for (std::size_t c = 0; c < chunk_count; ++c) {
+        const Chunk& chunk = chunks[c];
+        if (chunk.bad_row > 0) {
+            throw std::runtime_error("CSV row " + std::to_string(rows + chunk.bad_row) + " of this batch has " +
+                                     std::to_string(chunk.bad_fields) + " fields, expected " +
+                                     std::to_string(columns) + ".");
+        }
+        row_offset[c] = rows;
+        rows += chunk.rows;
+        for (std::size_t f = 0; f < columns; ++f) {
+            schema[f] = merge_kinds(schema[f], chunk.kinds[f]);
+            text_offset[c * columns + f] = total_text[f];
+            total_text[f] += chunk.text_bytes[f];
+        }
+    }
+
+    // Final buffers, written in place by pass 2
+    struct Target {
+        ColumnType type;
+        AlignedVector<std::int64_t> ints;
+        AlignedVector<double> doubles;
+        AlignedVector<char> chars;
+        AlignedVector<std::uint64_t> offsets;
+    };
+    std::vector<Target> targets(columns);
+    for (std::size_t f = 0; f < columns; ++f) {
+        Target& t = targets[f];
+        t.type = csv_column_type(schema[f]);
+        switch (t.type) {
+            case ColumnType::int64: t.ints.resize(rows); break;
+            case ColumnType::float64: t.doubles.resize(rows); break;
+            case ColumnType::character: t.chars.resize(rows); break;
+            default:
+                t.chars.resize(total_text[f]);
+                t.offsets.resize(rows + 1);
+        }
+    }
+
+    // Pass 2: convert every field into its column
+    parallel_for(chunk_count, threads, [&](std::size_t c, unsigned) {
+        Chunk& chunk = chunks[c];
+        chunk.null_rows.assign(columns, {});
+        std::vector<std::size_t> text(text_offset.begin() + c * columns, text_offset.begin() + (c + 1) * columns);
+        std::size_t row = row_offset[c];
+        std::vector<CsvField> fields;
+        for_each_csv_line(chunk.begin, chunk.end, [&](std::string_view line) {
+            split_csv_line(line, options.delimiter, fields);
+            for (std::size_t f = 0; f < columns; ++f) {
+                const CsvField& field = fields[f];
+                Target& t = targets[f];
+                const bool null = field.text.empty();
+                if (null) chunk.null_rows[f].push_back(row);
+                const char* first = field.text.data();
+                const char* last = first + field.text.size();
+                switch (t.type) {
+                    case ColumnType::int64:
+                        if (!null) std::from_chars(first, last, t.ints[row]);
+                        break;
+                    case ColumnType::float64:
+                        if (null) t.doubles[row] = std::numeric_limits<double>::quiet_NaN();
+                        else std::from_chars(first, last, t.doubles[row]);
+                        break;
+                    case ColumnType::character:
+                        t.chars[row] = null ? '\0' : field.text[0];
+                        break;
+                    default:
+                        field.copy_to(t.chars.data() + text[f]);
+                        text[f] += field.unescaped_size();
+                        t.offsets[row + 1] = text[f];
+                }
+            }
+            ++row;
+        });
+    });
+
+    DataFrame df;
+    for (std::size_t f = 0; f < columns; ++f) {
+        Target& t = targets[f];
+        std::size_t nulls = 0;
+        for (const Chunk& chunk : chunks) nulls += chunk.null_rows[f].size();
+        AlignedVector<std::uint64_t> validity;
+        if (nulls > 0) {
+            validity.assign((rows + 63) / 64, ~std::uint64_t(0));
+            for (const Chunk& chunk : chunks) {
+                for (std::size_t row : chunk.null_rows[f]) validity[row / 64] &= ~(std::uint64_t(1) << (row % 64));
+            }
+        }
+        Buffer values, offsets;
+        switch (t.type) {
+            case ColumnType::int64: values = Buffer::adopt(std::move(t.ints)); break;
+            case ColumnType::float64: values = Buffer::adopt(std::move(t.doubles)); break;
+            case ColumnType::character: values = Buffer::adopt(std::move(t.chars)); break;
+            default:
+                values = Buffer::adopt(std::move(t.chars));
+                offsets = Buffer::adopt(std::move(t.offsets));
+        }
+        add_column(df, names[f],
+                   Column::from_buffers(t.type, rows, std::move(values), std::move(offsets),
+                                        Buffer::adopt(std::move(validity)), nulls));
+    }
+    return df;
+}
+
+// Streaming CSV reader over a memory-mapped file. Each next_batch()
+// parses about options.batch_bytes of complete lines (the whole file if
+// 0) and then drops those pages from the mapping, so memory stays flat
+// however large the file is. Column kinds carry over between batches
+// and only widen, so a later batch may hold a wider type than an earlier
+// one (e.g. float64 after int64).
+class CsvReader {
+public:
+    explicit CsvReader(const std::string& path, CsvOptions options = {})
+        : file_(std::make_shared<MappedFile>(path)), options_(options) {
+        const char* begin = file_->data();
+        const char* end = begin + file_->size();
+        file_->advise(0, file_->size(), MADV_SEQUENTIAL);
+        // Skip leading blank lines
+        while (begin < end && (*begin == '\n' || *begin == '\r')) ++begin;
+        next_ = begin;
+        if (begin == end) return;
+        const char* line_end = next_line(begin, end);
+        std::string_view first(begin, static_cast<std::size_t>(line_end - begin));
+        if (!first.empty() && first.back() == '\n') first.remove_suffix(1);
+        std::vector<CsvField> fields;
+        split_csv_line(first, options_.delimiter, fields);
+        for (std::size_t f = 0; f < fields.size(); ++f) {
+            if (!options_.header) {
+                names_.push_back("column_" + std::to_string(f));
+                continue;
+            }
+            std::string name(fields[f].unescaped_size(), '\0');
+            fields[f].copy_to(name.data());
+            names_.push_back(std::move(name));
+        }
+        if (options_.header) next_ = line_end;
+        schema_.assign(names_.size(), CsvKind::empty);
+    }
+
+    const std::vector<std::string>& column_names() const { return names_; }
+
+    bool done() const { return next_ >= file_->data() + file_->size(); }
+
+    std::optional<DataFrame> next_batch() {
+        if (done()) return std::nullopt;
+        const char* end = file_->data() + file_->size();
+        const char* stop = end;
+        if (options_.batch_bytes > 0 && static_cast<std::size_t>(end - next_) > options_.batch_bytes) {
+            stop = next_line(next_ + options_.batch_bytes - 1, end);
+        }
+        DataFrame batch = parse_csv_region(next_, stop, names_, schema_, options_);
+        if (options_.categorical) encode_categorical(batch);
+        file_->release(static_cast<std::size_t>(next_ - file_->data()), static_cast<std::size_t>(stop - next_));
+        next_ = stop;
+        return batch;
+    }
+
+private:
+    // Dictionary-encode the string columns in which values repeat (at
+    // most half the rows distinct); keep the others as they are
+    void encode_categorical(DataFrame& batch) const {
+        parallel_for(batch.columns.size(), options_.threads, [&](std::size_t c, unsigned) {
+            Column& column = batch.columns[c];
+            if (column.type() != ColumnType::string) return;
+            Column encoded = encode_dictionary(column);
+            if (encoded.dictionary()->size() * 2 <= column.size()) column = std::move(encoded);
+        });
+    }
+
+    std::shared_ptr<MappedFile> file_;
+    CsvOptions options_;
+    std::vector<std::string> names_;
+    std::vector<CsvKind> schema_;
+    const char* next_ = nullptr;
+};
+
+// Load a whole CSV file into a DataFrame (see CsvReader)
+DataFrame read_csv(const std::string& path, CsvOptions options = {}) {
+    options.batch_bytes = 0;
+    CsvReader reader(path, options);
+    if (auto batch = reader.next_batch()) return std::move(*batch);
+    // Header only (or empty file): named, empty columns
+    DataFrame df;
+    for (const auto& name : reader.column_names()) add_column(df, name, Column());
+    return df;
+}
+
+/**************************************************************
+*                 GATHERING ROWS BY INDEX                     *
+**************************************************************/
+
+// Row index that gathers a null instead of a row
+constexpr std::size_t null_row = std::numeric_limits<std::size_t>::max();
+
+// The given rows of a column, in the given order
+Column take(const Column& column, const std::vector<std::size_t>& rows) {
+    const std::size_t n = rows.size();
+    bool gathers_nulls = column.null_count() > 0;
+    for (std::size_t r : rows) {
+        if (r == null_row) gathers_nulls = true;
+        else if (r >= column.size()) throw std::out_of_range("Row index is past the end of the column.");
+    }
+
+    if (column.type() == ColumnType::string) {
+        ColumnBuilder builder(ColumnType::string, n);
+        for (std::size_t r : rows) {
+            if (r == null_row || column.is_null(r)) builder.append_null();
+            else builder.append_string(column.string_at(r));
+        }
+        return builder.finish();
+    }
+
+    AlignedVector<std::uint64_t> validity;
+    std::size_t nulls = 0;
+    if (gathers_nulls) {
+        validity.assign((n + 63) / 64, 0);
+        for (std::size_t k = 0; k < n; ++k) {
+            if (rows[k] != null_row && !column.is_null(rows[k])) validity[k / 64] |= std::uint64_t(1) << (k % 64);
+            else ++nulls;
+        }
+    }
+    auto gather = [&](auto zero) {
+        using T = decltype(zero);
+        const T* in;
+        if constexpr (std::is_same_v<T, std::int32_t>) in = column.codes();
+        else in = column.values<T>();
+        const T fill = std::is_same_v<T, double> ? std::numeric_limits<double>::quiet_NaN()
+                     : std::is_same_v<T, std::int32_t> ? T(-1)
+                     : zero;
+        AlignedVector<T> out(n);
+        for (std::size_t k = 0; k < n; ++k) out[k] = rows[k] == null_row ? fill : in[rows[k]];
+        return Buffer::adopt(std::move(out));
+    };
+    Buffer validity_buffer = nulls > 0 ? Buffer::adopt(std::move(validity)) : Buffer{};
+    // Dictionary columns gather codes and keep sharing their dictionary
+    if (column.type() == ColumnType::dictionary) {
+        return Column::from_dictionary(n, gather(std::int32_t{0}), column.dictionary(), std::move(validity_buffer), nulls);
+    }
+    Buffer values = column.type() == ColumnType::int64 ? gather(std::int64_t{0})
+                  : column.type() == ColumnType::float64 ? gather(0.0)
+                  : gather(char{0});
+    return Column::from_buffers(column.type(), n, std::move(values), {}, std::move(validity_buffer), nulls);
+}
+
+// The given rows of every column of a frame
+DataFrame take(const DataFrame& df, const std::vector<std::size_t>& rows, unsigned threads = 0) {
+    DataFrame out;
+    out.column_names = df.column_names;
+    out.columns.resize(df.columns.size());
+    parallel_for(df.columns.size(), threads, [&](std::size_t c, unsigned) { out.columns[c] = take(df.columns[c], rows); });
+    return out;
+}
+
+/**************************************************************
+*                 LAZY COLUMN EXPRESSIONS                     *
+**************************************************************/
+
+// df["a"] * df["b"] + 2.0 or df["price"] > 10.0 only builds a tree of
+// ExprNodes; nothing runs until the tree is evaluated, reduced or used as
+// a filter. Evaluation walks the rows in chunks: each node produces one
+// chunk into its own small scratch buffer, column leaves are read in
+// place, and every operator is a plain loop the compiler vectorizes. An
+// expression is therefore one pass over its input columns, and the only
+// full-size allocation is the result (if it is materialized at all).
+
+// A chunk of doubles is 16 KiB, so the scratch of a few nodes stays in
+// L2. Chunks are whole validity words (a multiple of 64 rows), so tasks
+// never write to the same word.
+constexpr std::size_t expr_chunk_rows = 2048;
+constexpr std::size_t expr_chunks_per_task = 32;
+
+// Value type of an expression. Text (char and string columns, text
+// literals) can only be compared for (in)equality.
+enum class ValueType : std::uint8_t { int64, float64, boolean, text };
+
+const char* value_type_name(ValueType type) {
+    switch (type) {
+        case ValueType::int64: return "int64";
+        case ValueType::float64: return "float64";
+        case ValueType::boolean: return "boolean";
+        default: return "text";
+    }
+}
+
+enum class ExprOp : std::uint8_t {
+    column, literal,
+    add, subtract, multiply, divide, negate, abs, sqrt,
+    less, less_equal, greater, greater_equal, equal, not_equal,
+    logical_and, logical_or, logical_not,
+    cast, is_null, fill_null
+};
+
+struct ExprNode {
+    ExprOp op = ExprOp::literal;
+    ValueType type = ValueType::float64;
+    bool scalar = true;          // no column below: a literal broadcast to any length
+    std::size_t rows = 0;        // length when not scalar
+    Column column;               // ExprOp::column
+    std::int64_t integer = 0;    // int64 literal
+    double number = 0;           // numeric literal (as double, for int64 too)
+    std::string text;            // text literal
+    std::vector<std::shared_ptr<const ExprNode>> args;
+};
+
+// Summary of an expression's non-null values
+struct ExprSummary {
+    std::size_t count = 0;
+    double sum = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+
+    double mean() const { return count > 0 ? sum / static_cast<double>(count) : std::numeric_limits<double>::quiet_NaN(); }
+};
+
+// Handle to an immutable expression tree; copies share the tree
+class Expr {
+public:
+    // Read a column in place
+    explicit Expr(const Column& column) {
+        auto node = std::make_shared<ExprNode>();
+        node->op = ExprOp::column;
+        node->column = column;
+        node->scalar = false;
+        node->rows = column.size();
+        node->type = column.type() == ColumnType::int64 ? ValueType::int64
+                   : column.type() == ColumnType::float64 ? ValueType::float64
+                   : ValueType::text;
+        node_ = std::move(node);
+    }
+
+    // Literals
+    Expr(int value) : Expr(std::int64_t{value}) {}
+    Expr(std::int64_t value) {
+        auto node = std::make_shared<ExprNode>();
+        node->type = ValueType::int64;
+        node->integer = value;
+        node->number = static_cast<double>(value);
+        node_ = std::move(node);
+    }
+    Expr(double value) {
+        auto node = std::make_shared<ExprNode>();
+        node->number = value;
+        node_ = std::move(node);
+    }
+    Expr(char value) : Expr(std::string(1, value)) {}
+    Expr(const char* value) : Expr(std::string(value)) {}
+    Expr(std::string value) {
+        auto node = std::make_shared<ExprNode>();
+        node->type = ValueType::text;
+        node->text = std::move(value);
+        node_ = std::move(node);
+    }
+
+    // Operator node over `args`; checks they have one length
+    static Expr make(ExprOp op, ValueType type, std::vector<Expr> args) {
+        auto node = std::make_shared<ExprNode>();
+        node->op = op;
+        node->type = type;
+        for (const Expr& arg : args) {
+            if (!arg.node_->scalar) {
+                if (!node->scalar && node->rows != arg.node_->rows) {
+                    throw std::invalid_argument("Expression combines columns of different lengths.");
+                }
+                node->scalar = false;
+                node->rows = arg.node_->rows;
+            }
+            node->args.push_back(arg.node_);
+        }
+        return Expr(std::move(node));
+    }
+
+    const ExprNode& node() const { return *node_; }
+    ValueType type() const { return node_->type; }
+    bool is_scalar() const { return node_->scalar; }
+    std::size_t size() const { return node_->rows; }
+
+    Expr cast(ColumnType type) const;
+    Expr abs() const;
+    Expr sqrt() const;
+    Expr is_null() const;
+    // Null rows replaced by the rows (or literal) of `value`
+    Expr fill_null(const Expr& value) const;
+
+    // Materialize the values as a column; booleans become int64 0/1
+    Column evaluate(unsigned threads = 0) const;
+    // Count, sum, min and max of the non-null values, without
+    // materializing them
+    ExprSummary summarize(unsigned threads = 0) const;
+
+private:
+    explicit Expr(std::shared_ptr<const ExprNode> node) : node_(std::move(node)) {}
+
+    std::shared_ptr<const ExprNode> node_;
+};
+
+bool is_numeric_value(ValueType type) { return type == ValueType::int64 || type == ValueType::float64; }
+
+// Type of arithmetic on a and b: int64 when both are, float64 otherwise
+ValueType arithmetic_type(const Expr& a, const Expr& b, const char* op) {
+    if (!is_numeric_value(a.type()) || !is_numeric_value(b.type())) {
+        throw std::invalid_argument(std::string("Cannot apply ") + op + " to " + value_type_name(a.type()) + " and " +
+                                    value_type_name(b.type()) + " values.");
+    }
+    return a.type() == ValueType::int64 && b.type() == ValueType::int64 ? ValueType::int64 : ValueType::float64;
+}
+
+Expr operator+(const Expr& a, const Expr& b) { return Expr::make(ExprOp::add, arithmetic_type(a, b, "+"), {a, b}); }
+Expr operator-(const Expr& a, const Expr& b) { return Expr::make(ExprOp::subtract, arithmetic_type(a, b, "-"), {a, b}); }
+Expr operator*(const Expr& a, const Expr& b) { return Expr::make(ExprOp::multiply, arithmetic_type(a, b, "*"), {a, b}); }
+Expr operator/(const Expr& a, const Expr& b) {
+    arithmetic_type(a, b, "/");
+    return Expr::make(ExprOp::divide, ValueType::float64, {a, b});
+}
+Expr operator-(const Expr& a) { return Expr::make(ExprOp::negate, arithmetic_type(a, a, "unary -"), {a}); }
+
+Expr Expr::abs() const { return make(ExprOp::abs, arithmetic_type(*this, *this, "abs"), {*this}); }
+Expr Expr::sqrt() const {
+    arithmetic_type(*this, *this, "sqrt");
+    return make(ExprOp::sqrt, ValueType::float64, {*this});
+}
+
+// Numbers compare with numbers, text with text (for == and != only)
+Expr comparison(ExprOp op, const Expr& a, const Expr& b, const char* name) {
+    const bool text = a.type() == ValueType::text && b.type() == ValueType::text;
+    if (!(text && (op == ExprOp::equal || op == ExprOp::not_equal))) arithmetic_type(a, b, name);
+    return Expr::make(op, ValueType::boolean, {a, b});
+}
+
+Expr operator<(const Expr& a, const Expr& b) { return comparison(ExprOp::less, a, b, "<"); }
+Expr operator<=(const Expr& a, const Expr& b) { return comparison(ExprOp::less_equal, a, b, "<="); }
+Expr operator>(const Expr& a, const Expr& b) { return comparison(ExprOp::greater, a, b, ">"); }
+Expr operator>=(const Expr& a, const Expr& b) { return comparison(ExprOp::greater_equal, a, b, ">="); }
+Expr operator==(const Expr& a, const Expr& b) { return comparison(ExprOp::equal, a, b, "=="); }
+Expr operator!=(const Expr& a, const Expr& b) { return comparison(ExprOp::not_equal, a, b, "!="); }
+
+Expr logical(ExprOp op, const std::vector<Expr>& args, const char* name) {
+    for (const Expr& arg : args) {
+        if (arg.type() != ValueType::boolean) {
+            throw std::invalid_argument(std::string("Cannot apply ") + name + " to " + value_type_name(arg.type()) +
+                                        " values; compare them first.");
+        }
+    }
+    return Expr::make(op, ValueType::boolean, args);
+}
+
+// Element-wise and/or/not of boolean expressions (no short circuit)
+Expr operator&(const Expr& a, const Expr& b) { return logical(ExprOp::logical_and, {a, b}, "&"); }
+Expr operator|(const Expr& a, const Expr& b) { return logical(ExprOp::logical_or, {a, b}, "|"); }
+Expr operator!(const Expr& a) { return logical(ExprOp::logical_not, {a}, "!"); }
+
+// Numbers and booleans cast to int64 or float64. float64 to int64
+// truncates; NaN, infinities and out-of-range values become null.
+Expr Expr::cast(ColumnType type) const {
+    if (type != ColumnType::int64 && type != ColumnType::float64) {
+        throw std::invalid_argument(std::string("Expressions cast to int64 or float64, not ") + column_type_name(type) + ".");
+    }
+    if (node_->type == ValueType::text) throw std::invalid_argument("Cannot cast text values to numbers.");
+    return make(ExprOp::cast, type == ColumnType::int64 ? ValueType::int64 : ValueType::float64, {*this});
+}
+
+Expr Expr::is_null() const { return make(ExprOp::is_null, ValueType::boolean, {*this}); }
+
+Expr Expr::fill_null(const Expr& value) const {
+    ValueType type = ValueType::boolean;
+    if (node_->type != ValueType::boolean || value.type() != ValueType::boolean) {
+        type = arithmetic_type(*this, value, "fill_null");
+    }
+    return make(ExprOp::fill_null, type, {*this, value});
+}
+
+Expr DataFrame::operator[](const std::string& name) const { return Expr(columns[column_index(*this, name)]); }
+
+// One chunk of a node's values: a pointer into a column or a scratch
+// buffer, or a broadcast literal. valid[k] is 0 for null rows; a null
+// pointer means the chunk has no nulls.
+struct ExprChunk {
+    ValueType type = ValueType::float64;
+    bool scalar = false;
+    const std::int64_t* ints = nullptr;
+    const double* doubles = nullptr;
+    const std::uint8_t* bools = nullptr;
+    std::int64_t int_value = 0;
+    double double_value = 0;
+    std::string_view text_value;
+    const Column* text = nullptr;  // char or string column, from row0
+    std::size_t row0 = 0;
+    const std::uint8_t* valid = nullptr;
+};
+
+// Call f with an accessor k -> value k of the chunk as a T
+template <typename T, typename F>
+void with_chunk_values(const ExprChunk& c, F&& f) {
+    if (c.scalar) {
+        const T v = c.type == ValueType::int64 ? static_cast<T>(c.int_value) : static_cast<T>(c.double_value);
+        f([v](std::size_t) { return v; });
+    } else if (c.type == ValueType::int64) {
+        const std::int64_t* p = c.ints;
+        f([p](std::size_t k) { return static_cast<T>(p[k]); });
+    } else if (c.type == ValueType::boolean) {
+        const std::uint8_t* p = c.bools;
+        f([p](std::size_t k) { return static_cast<T>(p[k]); });
+    } else if constexpr (std::is_same_v<T, double>) {
+        const double* p = c.doubles;
+        f([p](std::size_t k) { return p[k]; });
+    } else {
+        throw std::logic_error("float64 values read as int64.");
+    }
+}
+
+std::string_view chunk_text(const ExprChunk& c, std::size_t k) {
+    if (c.scalar) return c.text_value;
+    if (c.text->type() == ColumnType::character) return {c.text->values<char>() + c.row0 + k, 1};
+    return c.text->string_at(c.row0 + k);
+}
+
+// Evaluates one expression chunk by chunk. Each node owns chunk-sized
+// scratch buffers, so an evaluator belongs to one thread. A node reached
+// twice in the same chunk (a shared subexpression) is computed once.
+class ExprEvaluator {
+public:
+    explicit ExprEvaluator(const ExprNode& root) : root_(root) {}
+
+    ExprChunk chunk(std::size_t row0, std::size_t n) { return eval(root_, row0, n); }
+
+private:
+    struct Scratch {
+        AlignedVector<std::int64_t> ints;
+        AlignedVector<double> doubles;
+        AlignedVector<std::uint8_t> bools, valid;
+        std::size_t row0 = null_row;
+        ExprChunk result;
+    };
+
+    static std::int64_t* ints(Scratch& s) {
+        if (s.ints.empty()) s.ints.resize(expr_chunk_rows);
+        return s.ints.data();
+    }
+    static double* doubles(Scratch& s) {
+        if (s.doubles.empty()) s.doubles.resize(expr_chunk_rows);
+        return s.doubles.data();
+    }
+    static std::uint8_t* bools(Scratch& s) {
+        if (s.bools.empty()) s.bools.resize(expr_chunk_rows);
+        return s.bools.data();
+    }
+    static std::uint8_t* valid(Scratch& s) {
+        if (s.valid.empty()) s.valid.resize(expr_chunk_rows);
+        return s.valid.data();
+    }
+
+    // Rows valid in both a and b
+    static const std::uint8_t* both_valid(const ExprChunk& a, const ExprChunk& b, std::size_t n, Scratch& s) {
+        if (!a.valid) return b.valid;
+        if (!b.valid) return a.valid;
+        std::uint8_t* out = valid(s);
+        for (std::size_t k = 0; k < n; ++k) out[k] = a.valid[k] & b.valid[k];
+        return out;
+    }
+
+    ExprChunk eval(const ExprNode& node, std::size_t row0, std::size_t n) {
+        Scratch& s = scratch_[&node];
+        if (s.row0 != row0) {
+            s.result = compute(node, row0, n, s);
+            s.row0 = row0;
+        }
+        return s.result;
+    }
+
+    ExprChunk compute(const ExprNode& node, std::size_t row0, std::size_t n, Scratch& s) {
+        ExprChunk out;
+        out.type = node.type;
+        switch (node.op) {
+            case ExprOp::column: column_chunk(node.column, row0, n, s, out); return out;
+            case ExprOp::literal:
+                out.scalar = true;
+                out.int_value = node.integer;
+                out.double_value = node.number;
+                out.text_value = node.text;
+                return out;
+            default: break;
+        }
+
+        const ExprChunk a = eval(*node.args[0], row0, n);
+        const ExprChunk b = node.args.size() > 1 ? eval(*node.args[1], row0, n) : ExprChunk{};
+        if (node.args.size() > 1) out.valid = both_valid(a, b, n, s);
+        else out.valid = a.valid;
+
+        switch (node.op) {
+            case ExprOp::add: arithmetic(a, b, n, s, out, [](auto x, auto y) { return wrap(x, y, std::plus<>()); }); break;
+            case ExprOp::subtract:
+                arithmetic(a, b, n, s, out, [](auto x, auto y) { return wrap(x, y, std::minus<>()); });
+                break;
+            case ExprOp::multiply:
+                arithmetic(a, b, n, s, out, [](auto x, auto y) { return wrap(x, y, std::multiplies<>()); });
+                break;
+            case ExprOp::divide: arithmetic(a, b, n, s, out, [](auto x, auto y) { return x / y; }); break;
+            case ExprOp::negate: arithmetic(a, a, n, s, out, [](auto x, auto) { return wrap(decltype(x)(0), x, std::minus<>()); }); break;
+            case ExprOp::abs: arithmetic(a, a, n, s, out, [](auto x, auto) { return x < 0 ? wrap(decltype(x)(0), x, std::minus<>()) : x; }); break;
+            case ExprOp::sqrt: arithmetic(a, a, n, s, out, [](auto x, auto) { return std::sqrt(x); }); break;
+            case ExprOp::less: compare(a, b, n, s, out, std::less<>()); break;
+            case ExprOp::less_equal: compare(a, b, n, s, out, std::less_equal<>()); break;
+            case ExprOp::greater: compare(a, b, n, s, out, std::greater<>()); break;
+            case ExprOp::greater_equal: compare(a, b, n, s, out, std::greater_equal<>()); break;
+            case ExprOp::equal: compare(a, b, n, s, out, std::equal_to<>()); break;
+            case ExprOp::not_equal: compare(a, b, n, s, out, std::not_equal_to<>()); break;
+            case ExprOp::logical_and: logic(a, b, n, s, out, [](std::uint8_t x, std::uint8_t y) { return x & y; }); break;
+            case ExprOp::logical_or: logic(a, b, n, s, out, [](std::uint8_t x, std::uint8_t y) { return x | y; }); break;
+            case ExprOp::logical_not: logic(a, a, n, s, out, [](std::uint8_t x, std::uint8_t) { return x ^ 1; }); break;
+            case ExprOp::cast: cast(a, n, s, out); break;
+            case ExprOp::is_null: {
+                std::uint8_t* result = bools(s);
+                for (std::size_t k = 0; k < n; ++k) result[k] = a.valid ? a.valid[k] ^ 1 : 0;
+                out.bools = result;
+                out.valid = nullptr;
+                break;
+            }
+            default: fill_null(a, b, n, s, out); break;
+        }
+        return out;
+    }
+
+    // Signed integer arithmetic wraps around (through unsigned) instead of
+    // overflowing; doubles are computed directly
+    template <typename T, typename Op>
+    static T wrap(T x, T y, Op op) {
+        if constexpr (std::is_same_v<T, std::int64_t>) {
+            return static_cast<std::int64_t>(op(static_cast<std::uint64_t>(x), static_cast<std::uint64_t>(y)));
+        } else {
+            return op(x, y);
+        }
+    }
+
+    static void column_chunk(const Column& column, std::size_t row0, std::size_t n, Scratch& s, ExprChunk& out) {
+        switch (column.type()) {
+            case ColumnType::int64: out.ints = column.values<std::int64_t>() + row0; break;
+            case ColumnType::float64: out.doubles = column.values<double>() + row0; break;
+            default:
+                out.text = &column;
+                out.row0 = row0;
+        }
+        if (column.null_count() > 0) {
+            const std::uint64_t* words = column.validity_buffer().as<std::uint64_t>();
+            std::uint8_t* v = valid(s);
+            for (std::size_t k = 0; k < n; ++k) v[k] = (words[(row0 + k) / 64] >> ((row0 + k) % 64)) & 1u;
+            out.valid = v;
+        }
+    }
+
+    // out[k] = op(a[k], b[k]) in the node's type (int64 or float64)
+    template <typename Op>
+    static void arithmetic(const ExprChunk& a, const ExprChunk& b, std::size_t n, Scratch& s, ExprChunk& out, Op op) {
+        auto run = [&](auto* result) {
+            using T = std::remove_pointer_t<decltype(result)>;
+            with_chunk_values<T>(a, [&](auto x) {
+                with_chunk_values<T>(b, [&](auto y) {
+                    for (std::size_t k = 0; k < n; ++k) result[k] = static_cast<T>(op(x(k), y(k)));
+                });
+            });
+        };
+        if (out.type == ValueType::int64) {
+            std::int64_t* result = ints(s);
+            out.ints = result;
+            run(result);
+        } else {
+            double* result = doubles(s);
+            out.doubles = result;
+            run(result);
+        }
+    }
+
+    template <typename Op>
+    static void compare(const ExprChunk& a, const ExprChunk& b, std::size_t n, Scratch& s, ExprChunk& out, Op op) {
+        std::uint8_t* result = bools(s);
+        out.bools = result;
+        if (a.type == ValueType::text) {
+            if (compare_codes(a, b, n, result, op) || compare_codes(b, a, n, result, [&](auto x, auto y) { return op(y, x); })) {
+                return;
+            }
+            for (std::size_t k = 0; k < n; ++k) result[k] = op(chunk_text(a, k), chunk_text(b, k));
+            return;
+        }
+        auto run = [&](auto zero) {
+            using T = decltype(zero);
+            with_chunk_values<T>(a, [&](auto x) {
+                with_chunk_values<T>(b, [&](auto y) {
+                    for (std::size_t k = 0; k < n; ++k) result[k] = op(x(k), y(k));
+                });
+            });
+        };
+        if (a.type == ValueType::int64 && b.type == ValueType::int64) run(std::int64_t{0});
+        else run(0.0);
+    }
+
+    // (In)equality of a dictionary column with a literal, or with a column
+    // sharing its dictionary, compares int32 codes instead of strings
+    template <typename Op>
+    static bool compare_codes(const ExprChunk& a, const ExprChunk& b, std::size_t n, std::uint8_t* result, Op op) {
+        if (a.scalar || a.text->type() != ColumnType::dictionary) return false;
+        const std::int32_t* x = a.text->codes() + a.row0;
+        if (b.scalar) {
+            // A value missing from the dictionary gets a code no row has
+            const std::int32_t code = a.text->dictionary()->code_of(b.text_value).value_or(-2);
+            for (std::size_t k = 0; k < n; ++k) result[k] = op(x[k], code);
+            return true;
+        }
+        if (b.text->type() != ColumnType::dictionary || b.text->dictionary() != a.text->dictionary()) return false;
+        const std::int32_t* y = b.text->codes() + b.row0;
+        for (std::size_t k = 0; k < n; ++k) result[k] = op(x[k], y[k]);
+        return true;
+    }
+
+    template <typename Op>
+    static void logic(const ExprChunk& a, const ExprChunk& b, std::size_t n, Scratch& s, ExprChunk& out, Op op) {
+        std::uint8_t* result = bools(s);
+        for (std::size_t k = 0; k < n; ++k) result[k] = op(a.bools[k], b.bools[k]);
+        out.bools = result;
+    }
+
+    static void cast(const ExprChunk& a, std::size_t n, Scratch& s, ExprChunk& out) {
+        if (out.type == a.type) {
+            out = a;
+            return;
+        }
+        if (out.type == ValueType::float64) {
+            double* result = doubles(s);
+            out.doubles = result;
+            with_chunk_values<double>(a, [&](auto x) {
+                for (std::size_t k = 0; k < n; ++k) result[k] = x(k);
+            });
+            return;
+        }
+        std::int64_t* result = ints(s);
+        out.ints = result;
+        if (a.type == ValueType::boolean) {
+            for (std::size_t k = 0; k < n; ++k) result[k] = a.bools[k];
+            return;
+        }
+        // Truncate doubles; anything outside int64 (or NaN) becomes null
+        std::uint8_t* v = valid(s);
+        with_chunk_values<double>(a, [&](auto x) {
+            for (std::size_t k = 0; k < n; ++k) {
+                const bool fits = std::fabs(x(k)) < 9223372036854775808.0;
+                result[k] = fits ? static_cast<std::int64_t>(x(k)) : 0;
+                v[k] = static_cast<std::uint8_t>(fits) & (a.valid ? a.valid[k] : 1);
+            }
+        });
+        out.valid = v;
+    }
+
+    static void fill_null(const ExprChunk& a, const ExprChunk& b, std::size_t n, Scratch& s, ExprChunk& out) {
+        if (!a.valid && a.type == out.type) {
+            out = a;
+            return;
+        }
+        auto run = [&](auto* result) {
+            using T = std::remove_pointer_t<decltype(result)>;
+            with_chunk_values<T>(a, [&](auto x) {
+                with_chunk_values<T>(b, [&](auto y) {
+                    for (std::size_t k = 0; k < n; ++k) result[k] = !a.valid || a.valid[k] ? x(k) : y(k);
+                });
+            });
+        };
+        if (out.type == ValueType::boolean) {
+            std::uint8_t* result = bools(s);
+            out.bools = result;
+            run(result);
+        } else if (out.type == ValueType::int64) {
+            std::int64_t* result = ints(s);
+            out.ints = result;
+            run(result);
+        } else {
+            double* result = doubles(s);
+            out.doubles = result;
+            run(result);
+        }
+        // A row is null only where the value is null too
+        if (!a.valid || !b.valid) {
+            out.valid = nullptr;
+        } else {
+            std::uint8_t* v = valid(s);
+            for (std::size_t k = 0; k < n; ++k) v[k] = a.valid[k] | b.valid[k];
+            out.valid = v;
+        }
+    }
+
+    const ExprNode& root_;
+    std::unordered_map<const ExprNode*, Scratch> scratch_;
+};
+
+// Run f(evaluator, row0, n) over every chunk of a non-scalar expression,
+// with tasks of expr_chunks_per_task chunks spread over `threads` threads
+template <typename F>
+void for_each_expr_chunk(const Expr& expr, unsigned threads, F&& f) {
+    if (expr.is_scalar()) throw std::invalid_argument("Expression references no column, so it has no length.");
+    const std::size_t rows = expr.size();
+    const std::size_t task_rows = expr_chunk_rows * expr_chunks_per_task;
+    std::vector<std::optional<ExprEvaluator>> evaluators(resolve_threads(threads));
+    parallel_for((rows + task_rows - 1) / task_rows, threads, [&](std::size_t task, unsigned worker) {
+        if (!evaluators[worker]) evaluators[worker].emplace(expr.node());
+        const std::size_t end = std::min(rows, (task + 1) * task_rows);
+        for (std::size_t row0 = task * task_rows; row0 < end; row0 += expr_chunk_rows) {
+            const std::size_t n = std::min(expr_chunk_rows, end - row0);
+            f(task, worker, *evaluators[worker], row0, n);
+        }
+    });
+}
+
+Column Expr::evaluate(unsigned threads) const {
+    if (node_->op == ExprOp::column) return node_->column;
+    if (node_->type == ValueType::text) throw std::invalid_argument("Text expressions can only be compared.");
+    const std::size_t rows = node_->rows;
+    const bool doubles = node_->type == ValueType::float64;
+    AlignedVector<double> float_values(doubles ? rows : 0);
+    AlignedVector<std::int64_t> int_values(doubles ? 0 : rows);
+    AlignedVector<std::uint64_t> validity((rows + 63) / 64, ~std::uint64_t(0));
+    std::atomic<std::size_t> nulls{0};
+
+    for_each_expr_chunk(*this, threads, [&](std::size_t, unsigned, ExprEvaluator& evaluator, std::size_t row0, std::size_t n) {
+        const ExprChunk c = evaluator.chunk(row0, n);
+        if (doubles) {
+            double* out = float_values.data() + row0;
+            with_chunk_values<double>(c, [&](auto x) {
+                for (std::size_t k = 0; k < n; ++k) out[k] = x(k);
+            });
+        } else {
+            std::int64_t* out = int_values.data() + row0;
+            with_chunk_values<std::int64_t>(c, [&](auto x) {
+                for (std::size_t k = 0; k < n; ++k) out[k] = x(k);
+            });
+        }
+        if (!c.valid) return;
+        std::size_t chunk_nulls = 0;
+        for (std::size_t k = 0; k < n; ++k) {
+            if (c.valid[k]) continue;
+            ++chunk_nulls;
+            validity[(row0 + k) / 64] &= ~(std::uint64_t(1) << ((row0 + k) % 64));
+            if (doubles) float_values[row0 + k] = std::numeric_limits<double>::quiet_NaN();
+            else int_values[row0 + k] = 0;
+        }
+        nulls += chunk_nulls;
+    });
+
+    Buffer values = doubles ? Buffer::adopt(std::move(float_values)) : Buffer::adopt(std::move(int_values));
+    return Column::from_buffers(doubles ? ColumnType::float64 : ColumnType::int64, rows, std::move(values), {},
+                                nulls > 0 ? Buffer::adopt(std::move(validity)) : Buffer{}, nulls);
+}
+
+ExprSummary Expr::summarize(unsigned threads) const {
+    if (node_->type == ValueType::text) throw std::invalid_argument("Cannot summarize text values.");
+    std::vector<ExprSummary> partial(resolve_threads(threads));
+    for_each_expr_chunk(*this, threads, [&](std::size_t, unsigned worker, ExprEvaluator& evaluator, std::size_t row0, std::size_t n) {
+        const ExprChunk c = evaluator.chunk(row0, n);
+        // Eight independent accumulators let the compiler vectorize the
+        // reductions without reassociating floating-point sums
+        constexpr std::size_t lanes = 8;
+        double sum[lanes] = {}, lo[lanes], hi[lanes];
+        std::size_t count[lanes] = {};
+        std::fill(lo, lo + lanes, std::numeric_limits<double>::infinity());
+        std::fill(hi, hi + lanes, -std::numeric_limits<double>::infinity());
+        with_chunk_values<double>(c, [&](auto x) {
+            for (std::size_t k = 0; k < n; ++k) {
+                const std::size_t l = k % lanes;
+                const bool valid = !c.valid || c.valid[k];
+                const double v = x(k);
+                sum[l] += valid ? v : 0.0;
+                lo[l] = std::min(lo[l], valid ? v : std::numeric_limits<double>::infinity());
+                hi[l] = std::max(hi[l], valid ? v : -std::numeric_limits<double>::infinity());
+                count[l] += valid;
+            }
+        });
+        ExprSummary& s = partial[worker];
+        for (std::size_t l = 0; l < lanes; ++l) {
+            s.sum += sum[l];
+            s.min = std::min(s.min, lo[l]);
+            s.max = std::max(s.max, hi[l]);
+            s.count += count[l];
+        }
+    });
+    ExprSummary total;
+    for (const ExprSummary& s : partial) {
+        total.count += s.count;
+        total.sum += s.sum;
+        total.min = std::min(total.min, s.min);
+        total.max = std::max(total.max, s.max);
+    }
+    return total;
+}
+
+// Materialize an expression as a new column
+void add_column(DataFrame& df, const std::string& name, const Expr& expr) { add_column(df, name, expr.evaluate()); }
+
+// Rows (in order) where a boolean expression is true; null is not true
+std::vector<std::size_t> matching_rows(const Expr& predicate, unsigned threads = 0) {
+    if (predicate.type() != ValueType::boolean) {
+        throw std::invalid_argument("A filter needs a boolean expression, e.g. a comparison.");
+    }
+    const std::size_t task_rows = expr_chunk_rows * expr_chunks_per_task;
+    std::vector<std::vector<std::size_t>> found(predicate.is_scalar() ? 0 : (predicate.size() + task_rows - 1) / task_rows);
+    for_each_expr_chunk(predicate, threads, [&](std::size_t task, unsigned, ExprEvaluator& evaluator, std::size_t row0, std::size_t n) {
+        const ExprChunk c = evaluator.chunk(row0, n);
+        for (std::size_t k = 0; k < n; ++k) {
+            if (c.bools[k] && (!c.valid || c.valid[k])) found[task].push_back(row0 + k);
+        }
+    });
+    std::vector<std::size_t> rows;
+    for (const auto& part : found) rows.insert(rows.end(), part.begin(), part.end());
+    return rows;
+}
+
+// The rows of df where `predicate` (over df's columns) is true
+DataFrame filter(const DataFrame& df, const Expr& predicate, unsigned threads = 0) {
+    if (!predicate.is_scalar() && predicate.size() != df.row_count()) {
+        throw std::invalid_argument("Filter expression length does not match the DataFrame row count.");
+    }
+    return take(df, matching_rows(predicate, threads), threads);
+}
+
+/**************************************************************
+*                 GROUP-BY AND AGGREGATION                    *
+**************************************************************/
+
+// One cell of a key column, reduced to a canonical form so that keys
+// compare across column types and batches: integral doubles become
+// integers (1.0 groups with 1) and chars become one-character text.
+struct KeyValue {
+    enum class Kind : std::uint8_t { null, integer, real, text };
+    Kind kind = Kind::null;
+    std::int64_t integer = 0;
+    double real = 0;
+    std::string_view text;
+};
+
+KeyValue key_value(const Column& column, std::size_t row) {
+    KeyValue key;
+    if (column.is_null(row)) return key;
+    switch (column.type()) {
+        case ColumnType::int64:
+            key.kind = KeyValue::Kind::integer;
+            key.integer = column.values<std::int64_t>()[row];
+            break;
+        case ColumnType::float64: {
+            const double x = column.values<double>()[row];
+            if (x == std::trunc(x) && std::fabs(x) < 9223372036854775808.0) {
+                key.kind = KeyValue::Kind::integer;
+                key.integer = static_cast<std::int64_t>(x);
+            } else {
+                key.kind = KeyValue::Kind::real;
+                key.real = x;
+            }
+            break;
+        }
+        case ColumnType::character:
+            key.kind = KeyValue::Kind::text;
+            key.text = std::string_view(column.values<char>() + row, 1);
+            break;
+        default:
+            key.kind = KeyValue::Kind::text;
+            key.text = column.string_at(row);
+    }
+    return key;
+}
+
+bool operator==(const KeyValue& a, const KeyValue& b) {
+    if (a.kind != b.kind) return false;
+    switch (a.kind) {
+        case KeyValue::Kind::null: return true;
+        case KeyValue::Kind::integer: return a.integer == b.integer;
+        case KeyValue::Kind::real: return a.real == b.real || (std::isnan(a.real) && std::isnan(b.real));
+        default: return a.text == b.text;
+    }
+}
+
+// Sort order of keys: numbers (NaN last), then text, then null
+bool operator<(const KeyValue& a, const KeyValue& b) {
+    const bool a_number = a.kind == KeyValue::Kind::integer || a.kind == KeyValue::Kind::real;
+    const bool b_number = b.kind == KeyValue::Kind::integer || b.kind == KeyValue::Kind::real;
+    if (a_number && b_number) {
+        if (a.kind == KeyValue::Kind::integer && b.kind == KeyValue::Kind::integer) return a.integer < b.integer;
+        const double x = a.kind == KeyValue::Kind::integer ? static_cast<double>(a.integer) : a.real;
+        const double y = b.kind == KeyValue::Kind::integer ? static_cast<double>(b.integer) : b.real;
+        if (std::isnan(x) || std::isnan(y)) return !std::isnan(x) && std::isnan(y);
+        return x < y;
+    }
+    if (a.kind == KeyValue::Kind::text && b.kind == KeyValue::Kind::text) return a.text < b.text;
+    const auto rank = [](const KeyValue& v) {
+        return v.kind == KeyValue::Kind::null ? 2 : v.kind == KeyValue::Kind::text ? 1 : 0;
+    };
+    return rank(a) < rank(b);
+}
+
+// splitmix64 finalizer
+std::uint64_t mix64(std::uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+constexpr std::uint64_t null_key_hash = 0x6a09e667f3bcc908ULL;
+
+// Key hash of text whose std::hash is `text_hash` (dictionaries keep
+// these per value, so their rows never rehash strings)
+std::uint64_t text_key_hash(std::uint64_t text_hash) { return mix64(text_hash ^ 0xa54ff53a5f1d36f1ULL); }
+
+std::uint64_t hash_key(const KeyValue& key) {
+    switch (key.kind) {
+        case KeyValue::Kind::null: return null_key_hash;
+        case KeyValue::Kind::integer: return mix64(static_cast<std::uint64_t>(key.integer));
+        case KeyValue::Kind::real: {
+            if (std::isnan(key.real)) return 0xbb67ae8584caa73bULL;
+            std::uint64_t bits;
+            std::memcpy(&bits, &key.real, sizeof bits);
+            return mix64(bits ^ 0x3c6ef372fe94f82bULL);
+        }
+        default: return text_key_hash(std::hash<std::string_view>()(key.text));
+    }
+}
+
+// Fold one key column's hash into a row hash
+std::uint64_t combine_hash(std::uint64_t row_hash, std::uint64_t key_hash) {
+    return mix64(row_hash + 0x9e3779b97f4a7c15ULL + key_hash);
+}
+
+// Hashes of rows row0 .. row0+n over the key columns, computed a whole
+// column at a time
+void hash_key_rows(const std::vector<const Column*>& keys, std::size_t row0, std::size_t n, std::uint64_t* hashes) {
+    std::fill(hashes, hashes + n, 0);
+    for (const Column* key : keys) {
+        if (key->type() == ColumnType::dictionary) {
+            const std::int32_t* codes = key->codes() + row0;
+            const std::uint64_t* text_hashes = key->dictionary()->hashes.data();
+            const std::size_t dictionary_size = key->dictionary()->size();
+            for (std::size_t k = 0; k < n; ++k) {
+                std::uint64_t h = null_key_hash;
+                if (!key->is_null(row0 + k)) {
+                    // As in dictionary_string, codes read from a file are checked on use
+                    if (static_cast<std::uint32_t>(codes[k]) >= dictionary_size) {
+                        throw std::runtime_error("Column dictionary codes are corrupt.");
+                    }
+                    h = text_key_hash(text_hashes[codes[k]]);
+                }
+                hashes[k] = combine_hash(hashes[k], h);
+            }
+            continue;
+        }
+        for (std::size_t k = 0; k < n; ++k) hashes[k] = combine_hash(hashes[k], hash_key(key_value(*key, row0 + k)));
+    }
+}
+
+// Key cells of every group for one key column, owned by the table (so
+// groups outlive the batches they were first seen in). Each group takes
+// a kind byte and eight bytes: the integer, the double's bits, or the
+// offset of its text in one shared byte arena.
+class GroupKeyColumn {
+public:
+    std::size_t size() const { return kinds_.size(); }
+
+    KeyValue at(std::size_t group) const {
+        KeyValue key;
+        key.kind = kinds_[group];
+        const std::uint64_t bits = bits_[group];
+        switch (key.kind) {
+            case KeyValue::Kind::integer: key.integer = static_cast<std::int64_t>(bits); break;
+            case KeyValue::Kind::real: std::memcpy(&key.real, &bits, sizeof bits); break;
+            case KeyValue::Kind::text: key.text = std::string_view(text_.data() + bits, text_sizes_[group]); break;
+            default: break;
+        }
+        return key;
+    }
+
+    void append(const KeyValue& key) {
+        std::uint64_t bits = 0;
+        std::uint32_t text_size = 0;
+        switch (key.kind) {
+            case KeyValue::Kind::integer: bits = static_cast<std::uint64_t>(key.integer); break;
+            case KeyValue::Kind::real: std::memcpy(&bits, &key.real, sizeof bits); break;
+            case KeyValue::Kind::text:
+                bits = text_.size();
+                text_size = static_cast<std::uint32_t>(key.text.size());
+                text_.insert(text_.end(), key.text.begin(), key.text.end());
+                break;
+            default: break;
+        }
+        kinds_.push_back(key.kind);
+        bits_.push_back(bits);
+        text_sizes_.push_back(text_size);
+    }
+
+    void reserve(std::size_t groups) {
+        kinds_.reserve(groups);
+        bits_.reserve(groups);
+        text_sizes_.reserve(groups);
+    }
+
+private:
+    std::vector<KeyValue::Kind> kinds_;
+    std::vector<std::uint64_t> bits_;
+    std::vector<std::uint32_t> text_sizes_;
+    std::vector<char> text_;
 };
 
-// Function to add a column to the DataFrame
-void add_column(DataFrame& df, const std::string& name, const DataFrameColumn& column) {
-    // Ensure all columns have the same row count
-    if (!df.columns.empty() && df.columns[0].size() != column.size()) {
-        throw std::invalid_argument("Column size does not match existing DataFrame row count.");
+enum class Aggregate : std::uint8_t { count, sum, mean, min, max, variance };
+
+const char* aggregate_name(Aggregate op) {
+    switch (op) {
+        case Aggregate::count: return "count";
+        case Aggregate::sum: return "sum";
+        case Aggregate::mean: return "mean";
+        case Aggregate::min: return "min";
+        case Aggregate::max: return "max";
+        default: return "variance";
     }
-    df.column_names.push_back(name);
-    df.columns.push_back(column);
 }
 
-// Function to print the contents of the DataFrame
-void print_dataframe(const DataFrame& df) {
-    // Print column names
-    for (const auto& name : df.column_names) {
-        std::cout << name << "\t";
+Aggregate parse_aggregate(const std::string& name) {
+    for (Aggregate op : {Aggregate::count, Aggregate::sum, Aggregate::mean, Aggregate::min, Aggregate::max,
+                         Aggregate::variance}) {
+        if (name == aggregate_name(op)) return op;
     }
-    std::cout << std::endl;
+    throw std::invalid_argument("Unknown aggregate '" + name + "' (count, sum, mean, min, max or variance).");
+}
 
-    // Check if DataFrame is empty
-    if (df.columns.empty()) {
-        std::cout << "DataFrame is empty!" << std::endl;
-        return;
+// One output column of a group-by: op over the non-null values of
+// `column`. count accepts any column; the others need numbers.
+struct Aggregation {
+    std::string column;
+    Aggregate op = Aggregate::sum;
+    std::string name;  // output column name; "<column>_<op>" if empty
+
+    std::string output_name() const { return name.empty() ? column + "_" + aggregate_name(op) : name; }
+};
+
+// Running state of one aggregate of one group. mean and m2 (the sum of
+// squared deviations) are updated with Welford's method, so variances do
+// not suffer from cancellation, and combine with Chan's formula.
+struct AggregateState {
+    std::uint64_t count = 0;
+    double sum = 0;
+    double mean = 0;
+    double m2 = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+
+    void merge(const AggregateState& other) {
+        if (other.count == 0) return;
+        const double n = static_cast<double>(count + other.count);
+        const double delta = other.mean - mean;
+        m2 += other.m2 + delta * delta * static_cast<double>(count) * static_cast<double>(other.count) / n;
+        mean += delta * static_cast<double>(other.count) / n;
+        count += other.count;
+        sum += other.sum;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
     }
+};
 
-    // Print each row of the DataFrame
-    size_t row_count = df.columns[0].size();
-    for (size_t i = 0; i < row_count; ++i) {
-        for (const auto& column : df.columns) {
-            std::visit([](auto&& val) { std::cout << val << "\t"; }, column[i]);
+// Open-addressing (linear probing) hash table from group keys to dense
+// group ids, with each group's key cells, hash and aggregate states.
+// Slots store the full hash, so keys are only compared on a hash match.
+class GroupTable {
+public:
+    GroupTable(std::size_t key_columns, std::size_t aggregates)
+        : keys_(key_columns), aggregates_(aggregates), slots_(16, Slot{0, empty}) {}
+
+    std::size_t groups() const { return hashes_.size(); }
+
+    // Make room for `groups` groups without rehashing
+    void reserve(std::size_t groups) {
+        std::size_t slots = slots_.size();
+        while (slots < groups * 2) slots *= 2;
+        if (slots > slots_.size()) {
+            slots_.assign(slots / 2, Slot{0, empty});
+            grow();
         }
-        std::cout << std::endl;
+        hashes_.reserve(groups);
+        states_.reserve(groups * aggregates_);
+        for (auto& keys : keys_) keys.reserve(groups);
+    }
+
+    std::uint64_t hash(std::size_t group) const { return hashes_[group]; }
+    const GroupKeyColumn& keys(std::size_t c) const { return keys_[c]; }
+    AggregateState* states(std::size_t group) { return &states_[group * aggregates_]; }
+    const AggregateState* states(std::size_t group) const { return &states_[group * aggregates_]; }
+
+    // Group of the key whose cells key_at(c) gives, inserted if new
+    template <typename KeyAt>
+    std::uint32_t find_or_insert(std::uint64_t hash, KeyAt&& key_at) {
+        std::size_t mask = slots_.size() - 1;
+        for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+            Slot& slot = slots_[i];
+            if (slot.group == empty) {
+                const std::uint32_t group = static_cast<std::uint32_t>(hashes_.size());
+                slot = Slot{hash, group};
+                hashes_.push_back(hash);
+                for (std::size_t c = 0; c < keys_.size(); ++c) keys_[c].append(key_at(c));
+                states_.resize(states_.size() + aggregates_);
+                if (hashes_.size() * 2 > slots_.size()) grow();
+                return group;
+            }
+            if (slot.hash == hash && matches(slot.group, key_at)) return slot.group;
+        }
+    }
+
+private:
+    static constexpr std::uint32_t empty = std::numeric_limits<std::uint32_t>::max();
+
+    struct Slot {
+        std::uint64_t hash;
+        std::uint32_t group;
+    };
+
+    template <typename KeyAt>
+    bool matches(std::uint32_t group, KeyAt& key_at) const {
+        for (std::size_t c = 0; c < keys_.size(); ++c) {
+            if (!(keys_[c].at(group) == key_at(c))) return false;
+        }
+        return true;
+    }
+
+    void grow() {
+        std::vector<Slot> slots(slots_.size() * 2, Slot{0, empty});
+        const std::size_t mask = slots.size() - 1;
+        for (std::uint32_t g = 0; g < hashes_.size(); ++g) {
+            std::size_t i = hashes_[g] & mask;
+            while (slots[i].group != empty) i = (i + 1) & mask;
+            slots[i] = Slot{hashes_[g], g};
+        }
+        slots_ = std::move(slots);
+    }
+
+    std::vector<GroupKeyColumn> keys_;
+    std::size_t aggregates_;
+    std::vector<Slot> slots_;
+    std::vector<std::uint64_t> hashes_;
+    std::vector<AggregateState> states_;
+};
+
+// Hash group-by over one frame or a stream of batches with the same
+// column names. Each worker thread aggregates the rows it takes into its
+// own GroupTable, so threads share nothing while rows are added; result()
+// merges the per-thread tables, split by hash into partitions that are
+// merged in parallel. Groups come out sorted by key; null keys form a
+// group of their own. A key column that holds numbers in some batches
+// and text in others (a CSV column widened to string part way through)
+// groups the numbers by their text.
+class GroupBy {
+public:
+    GroupBy(std::vector<std::string> keys, std::vector<Aggregation> aggregations, unsigned threads = 0)
+        : keys_(std::move(keys)), aggregations_(std::move(aggregations)), threads_(resolve_threads(threads)),
+          key_types_(keys_.size()) {
+        if (keys_.empty()) throw std::invalid_argument("Group-by needs at least one key column.");
+        for (unsigned w = 0; w < threads_; ++w) partials_.emplace_back(keys_.size(), aggregations_.size());
+    }
+
+    void add(const DataFrame& batch) {
+        std::vector<const Column*> keys, values;
+        std::vector<Column> as_text;
+        as_text.reserve(keys_.size());
+        for (std::size_t c = 0; c < keys_.size(); ++c) {
+            keys.push_back(&batch.columns[column_index(batch, keys_[c])]);
+            if (note_key_type(c, *keys.back())) rekey_as_text(c);
+            if (key_types_[c].mixed() && keys.back()->is_numeric()) {
+                as_text.push_back(numbers_as_text(*keys.back()));
+                keys.back() = &as_text.back();
+            }
+        }
+        for (const Aggregation& aggregation : aggregations_) {
+            values.push_back(&batch.columns[column_index(batch, aggregation.column)]);
+            if (aggregation.op != Aggregate::count && !values.back()->is_numeric()) {
+                throw std::invalid_argument("Cannot take the " + std::string(aggregate_name(aggregation.op)) +
+                                            " of non-numeric column '" + aggregation.column + "'.");
+            }
+        }
+
+        const std::size_t rows = batch.row_count();
+        const std::size_t task_rows = expr_chunk_rows * expr_chunks_per_task;
+        parallel_for((rows + task_rows - 1) / task_rows, threads_, [&](std::size_t task, unsigned worker) {
+            GroupTable& table = partials_[worker];
+            std::vector<std::uint64_t> hashes(expr_chunk_rows);
+            std::vector<std::uint32_t> groups(expr_chunk_rows);
+            const std::size_t end = std::min(rows, (task + 1) * task_rows);
+            for (std::size_t row0 = task * task_rows; row0 < end; row0 += expr_chunk_rows) {
+                const std::size_t n = std::min(expr_chunk_rows, end - row0);
+                hash_key_rows(keys, row0, n, hashes.data());
+                for (std::size_t k = 0; k < n; ++k) {
+                    groups[k] = table.find_or_insert(hashes[k], [&](std::size_t c) { return key_value(*keys[c], row0 + k); });
+                }
+                for (std::size_t a = 0; a < values.size(); ++a) {
+                    accumulate(table, a, aggregations_[a].op, *values[a], row0, n, groups.data());
+                }
+            }
+        });
+    }
+
+    DataFrame result() const {
+        // Bucket every partial's groups by the top bits of their hash
+        constexpr unsigned partition_bits = 6;
+        constexpr std::size_t partitions = std::size_t(1) << partition_bits;
+        std::vector<std::vector<std::vector<std::uint32_t>>> buckets(partials_.size());
+        parallel_for(partials_.size(), threads_, [&](std::size_t p, unsigned) {
+            buckets[p].resize(partitions);
+            for (std::uint32_t g = 0; g < partials_[p].groups(); ++g) {
+                buckets[p][partials_[p].hash(g) >> (64 - partition_bits)].push_back(g);
+            }
+        });
+
+        std::vector<GroupTable> merged(partitions, GroupTable(keys_.size(), aggregations_.size()));
+        parallel_for(partitions, threads_, [&](std::size_t part, unsigned) {
+            std::size_t bound = 0;
+            for (const auto& partial_buckets : buckets) bound += partial_buckets[part].size();
+            merged[part].reserve(bound);
+            for (std::size_t p = 0; p < partials_.size(); ++p) {
+                const GroupTable& partial = partials_[p];
+                for (std::uint32_t g : buckets[p][part]) {
+                    const std::uint32_t group = merged[part].find_or_insert(
+                        partial.hash(g), [&](std::size_t c) { return partial.keys(c).at(g); });
+                    for (std::size_t a = 0; a < aggregations_.size(); ++a) {
+                        merged[part].states(group)[a].merge(partial.states(g)[a]);
+                    }
+                }
+            }
+        });
+
+        // Sort all groups by key, with the first key cell copied out so
+        // most comparisons touch only the array being sorted
+        struct Entry {
+            KeyValue first;
+            std::uint32_t part, group;
+        };
+        std::vector<Entry> order;
+        for (std::uint32_t part = 0; part < partitions; ++part) {
+            for (std::uint32_t g = 0; g < merged[part].groups(); ++g) order.push_back({merged[part].keys(0).at(g), part, g});
+        }
+        std::sort(order.begin(), order.end(), [&](const Entry& x, const Entry& y) {
+            if (x.first < y.first) return true;
+            if (y.first < x.first) return false;
+            for (std::size_t c = 1; c < keys_.size(); ++c) {
+                const KeyValue a = merged[x.part].keys(c).at(x.group);
+                const KeyValue b = merged[y.part].keys(c).at(y.group);
+                if (a < b) return true;
+                if (b < a) return false;
+            }
+            return false;
+        });
+
+        DataFrame out;
+        for (std::size_t c = 0; c < keys_.size(); ++c) {
+            const KeyTypes& seen = key_types_[c];
+            const ColumnType type = seen.text ? (seen.string || seen.mixed() ? ColumnType::string : ColumnType::character)
+                                  : seen.integer && !seen.real ? ColumnType::int64
+                                  : ColumnType::float64;
+            ColumnBuilder builder(type, order.size());
+            for (const Entry& e : order) {
+                const KeyValue key = merged[e.part].keys(c).at(e.group);
+                switch (key.kind) {
+                    case KeyValue::Kind::null: builder.append_null(); break;
+                    case KeyValue::Kind::integer:
+                        if (type == ColumnType::int64) builder.append_int64(key.integer);
+                        else builder.append_double(static_cast<double>(key.integer));
+                        break;
+                    case KeyValue::Kind::real: builder.append_double(key.real); break;
+                    default:
+                        if (type == ColumnType::character) builder.append_char(key.text[0]);
+                        else builder.append_string(key.text);
+                }
+            }
+            add_column(out, keys_[c], builder.finish());
+        }
+        for (std::size_t a = 0; a < aggregations_.size(); ++a) {
+            const Aggregate op = aggregations_[a].op;
+            ColumnBuilder builder(op == Aggregate::count ? ColumnType::int64 : ColumnType::float64, order.size());
+            for (const Entry& e : order) {
+                const AggregateState& s = merged[e.part].states(e.group)[a];
+                const double n = static_cast<double>(s.count);
+                switch (op) {
+                    case Aggregate::count: builder.append_int64(static_cast<std::int64_t>(s.count)); break;
+                    case Aggregate::variance:
+                        if (s.count < 2) builder.append_null();
+                        else builder.append_double(s.m2 / (n - 1));
+                        break;
+                    default:
+                        if (s.count == 0) builder.append_null();
+                        else builder.append_double(op == Aggregate::sum ? s.sum
+                                                   : op == Aggregate::mean ? s.sum / n
+                                                   : op == Aggregate::min ? s.min
+                                                   : s.max);
+                }
+            }
+            add_column(out, aggregations_[a].output_name(), builder.finish());
+        }
+        return out;
+    }
+
+private:
+    // Which kinds of non-null values a key column has held, to pick its
+    // output type (int64 widens to float64, char to string, and numbers
+    // mixed with text to string)
+    struct KeyTypes {
+        bool integer = false, real = false, text = false, string = false;
+
+        bool mixed() const { return text && (integer || real); }
+    };
+
+    // Record the kinds `column` holds; true if this batch is the first to
+    // mix numbers and text in key column c
+    bool note_key_type(std::size_t c, const Column& column) {
+        if (column.null_count() == column.size()) return false;
+        KeyTypes& seen = key_types_[c];
+        const bool was_mixed = seen.mixed();
+        seen.integer = seen.integer || column.type() == ColumnType::int64;
+        seen.real = seen.real || column.type() == ColumnType::float64;
+        seen.text = seen.text || !column.is_numeric();
+        seen.string = seen.string || column.type() == ColumnType::string || column.type() == ColumnType::dictionary;
+        return seen.mixed() && !was_mixed;
+    }
+
+    // Text a number key groups under once its column also holds text:
+    // integers (and integral doubles, as in key_value) in decimal, other
+    // doubles in the shortest form that reads back exactly
+    static std::string_view number_text(const KeyValue& key, char (&text)[32]) {
+        const auto [end, error] = key.kind == KeyValue::Kind::integer
+                                      ? std::to_chars(text, text + sizeof text, key.integer)
+                                      : std::to_chars(text, text + sizeof text, key.real);
+        return std::string_view(text, static_cast<std::size_t>(end - text));
+    }
+
+    static Column numbers_as_text(const Column& column) {
+        ColumnBuilder builder(ColumnType::string, column.size());
+        char text[32];
+        for (std::size_t row = 0; row < column.size(); ++row) {
+            const KeyValue key = key_value(column, row);
+            if (key.kind == KeyValue::Kind::null) builder.append_null();
+            else builder.append_string(number_text(key, text));
+        }
+        return builder.finish();
+    }
+
+    // Turn the number keys already grouped in column c into text and
+    // rehash their groups, so rows of later batches find them
+    void rekey_as_text(std::size_t c) {
+        for (GroupTable& partial : partials_) {
+            GroupTable table(keys_.size(), aggregations_.size());
+            table.reserve(partial.groups());
+            char text[32];
+            for (std::uint32_t g = 0; g < partial.groups(); ++g) {
+                auto key_at = [&](std::size_t k) {
+                    KeyValue key = partial.keys(k).at(g);
+                    if (k == c && (key.kind == KeyValue::Kind::integer || key.kind == KeyValue::Kind::real)) {
+                        key.text = number_text(key, text);
+                        key.kind = KeyValue::Kind::text;
+                    }
+                    return key;
+                };
+                std::uint64_t hash = 0;
+                for (std::size_t k = 0; k < keys_.size(); ++k) hash = combine_hash(hash, hash_key(key_at(k)));
+                const std::uint32_t group = table.find_or_insert(hash, key_at);
+                for (std::size_t a = 0; a < aggregations_.size(); ++a) {
+                    table.states(group)[a].merge(partial.states(g)[a]);
+                }
+            }
+            partial = std::move(table);
+        }
+    }
+
+    // Fold rows row0 .. row0+n of `column` into the states of aggregate a
+    static void accumulate(GroupTable& table, std::size_t a, Aggregate op, const Column& column, std::size_t row0,
+                           std::size_t n, const std::uint32_t* groups) {
+        if (op == Aggregate::count) {
+            for (std::size_t k = 0; k < n; ++k) table.states(groups[k])[a].count += !column.is_null(row0 + k);
+            return;
+        }
+        auto run = [&](const auto* values) {
+            for (std::size_t k = 0; k < n; ++k) {
+                if (column.is_null(row0 + k)) continue;
+                const double x = static_cast<double>(values[row0 + k]);
+                AggregateState& s = table.states(groups[k])[a];
+                ++s.count;
+                switch (op) {
+                    case Aggregate::min: s.min = std::min(s.min, x); break;
+                    case Aggregate::max: s.max = std::max(s.max, x); break;
+                    case Aggregate::variance: {
+                        const double delta = x - s.mean;
+                        s.mean += delta / static_cast<double>(s.count);
+                        s.m2 += delta * (x - s.mean);
+                        break;
+                    }
+                    default: s.sum += x;
+                }
+            }
+        };
+        if (column.type() == ColumnType::int64) run(column.values<std::int64_t>());
+        else run(column.values<double>());
     }
+
+    std::vector<std::string> keys_;
+    std::vector<Aggregation> aggregations_;
+    unsigned threads_;
+    std::vector<KeyTypes> key_types_;
+    std::vector<GroupTable> partials_;
+};
+
+// Group a whole frame by `keys` and aggregate (see GroupBy)
+DataFrame group_by(const DataFrame& df, const std::vector<std::string>& keys,
+                   const std::vector<Aggregation>& aggregations, unsigned threads = 0) {
+    GroupBy grouping(keys, aggregations, threads);
+    grouping.add(df);
+    return grouping.result();
 }
 
 /**************************************************************
-*        EXTRACTING NUMERIC DATA FOR EIGEN OPERATIONS         *
+*                           JOINS                             *
 **************************************************************/
 
-// Utility function to verify if a column contains only numeric values
-bool is_numeric_column(const DataFrameColumn& column) {
-    return std::all_of(column.begin(), column.end(), [](const DataFrameElement& val) {
-        return std::holds_alternative<int>(val) || std::holds_alternative<double>(val);
+enum class JoinType : std::uint8_t { inner, left };
+
+// automatic lets plan_join choose
+enum class JoinStrategy : std::uint8_t { automatic, hash, sort_merge };
+
+const char* join_strategy_name(JoinStrategy strategy) {
+    switch (strategy) {
+        case JoinStrategy::hash: return "hash";
+        case JoinStrategy::sort_merge: return "sort-merge";
+        default: return "automatic";
+    }
+}
+
+struct JoinOptions {
+    JoinType type = JoinType::inner;
+    JoinStrategy strategy = JoinStrategy::automatic;
+    unsigned threads = 0;
+    std::string suffix = "_right";  // added to right column names that clash with left ones
+};
+
+// Matched row pairs: rows first[i] and second[i] join. second[i] is
+// null_row for an unmatched row kept by a left join.
+struct JoinIndices {
+    std::vector<std::size_t> first, second;
+};
+
+std::vector<const Column*> key_columns(const DataFrame& df, const std::vector<std::string>& on) {
+    std::vector<const Column*> keys;
+    for (const std::string& name : on) keys.push_back(&df.columns[column_index(df, name)]);
+    return keys;
+}
+
+// -1, 0 or 1 as row i of a sorts before, with or after row j of b
+int compare_key_rows(const std::vector<const Column*>& a, std::size_t i, const std::vector<const Column*>& b,
+                     std::size_t j) {
+    for (std::size_t c = 0; c < a.size(); ++c) {
+        const KeyValue x = key_value(*a[c], i);
+        const KeyValue y = key_value(*b[c], j);
+        if (x < y) return -1;
+        if (y < x) return 1;
+    }
+    return 0;
+}
+
+bool has_null_key(const std::vector<const Column*>& keys, std::size_t row) {
+    for (const Column* key : keys) {
+        if (key->is_null(row)) return true;
+    }
+    return false;
+}
+
+// Whether the rows are in nondecreasing key order (in KeyValue order)
+bool sorted_by_keys(const std::vector<const Column*>& keys, std::size_t rows, unsigned threads = 0) {
+    const std::size_t task_rows = expr_chunk_rows * expr_chunks_per_task;
+    std::atomic<bool> sorted{true};
+    parallel_for((rows + task_rows - 1) / task_rows, threads, [&](std::size_t task, unsigned) {
+        // Each task also checks the pair straddling its end
+        const std::size_t end = std::min(rows - 1, (task + 1) * task_rows);
+        for (std::size_t row = task * task_rows; row < end && sorted; ++row) {
+            if (compare_key_rows(keys, row + 1, keys, row) < 0) sorted = false;
+        }
     });
+    return sorted;
 }
 
-// Extract numeric data (int or double) from a column to an Eigen vector
-Eigen::VectorXd extract_numeric_column(const DataFrameColumn& column) {
-    if (!is_numeric_column(column)) {
-        throw std::invalid_argument("Column contains non-numeric values, cannot extract as numeric.");
+// Partitioned hash join. The build side's rows are radix-partitioned by
+// the top bits of their key hash, and each partition (about 64K rows, so
+// its table stays in cache) gets its own table, built in parallel.
+// Probe rows are looked up in parallel chunks, and the pairs come out in
+// probe-row order, with the matches of each probe row in build-row
+// order. Null keys match nothing; unmatched probe rows are kept (paired
+// with null_row) if asked.
+JoinIndices hash_join(const std::vector<const Column*>& probe, std::size_t probe_rows,
+                      const std::vector<const Column*>& build, std::size_t build_rows, bool keep_unmatched,
+                      unsigned threads = 0) {
+    const std::size_t task_rows = expr_chunk_rows * expr_chunks_per_task;
+    const std::size_t build_tasks = (build_rows + task_rows - 1) / task_rows;
+    unsigned bits = 0;
+    while ((build_rows >> bits) > 65536 && bits < 10) ++bits;
+    const std::size_t partitions = std::size_t(1) << bits;
+    const auto partition_of = [bits](std::uint64_t hash) {
+        return bits == 0 ? std::size_t(0) : static_cast<std::size_t>(hash >> (64 - bits));
+    };
+
+    // Hash the build rows and count them per (task, partition)
+    std::vector<std::uint64_t> hashes(build_rows);
+    std::vector<std::size_t> offsets(build_tasks * partitions);
+    parallel_for(build_tasks, threads, [&](std::size_t task, unsigned) {
+        const std::size_t end = std::min(build_rows, (task + 1) * task_rows);
+        for (std::size_t row0 = task * task_rows; row0 < end; row0 += expr_chunk_rows) {
+            hash_key_rows(build, row0, std::min(expr_chunk_rows, end - row0), hashes.data() + row0);
+        }
+        for (std::size_t row = task * task_rows; row < end; ++row) {
+            if (!has_null_key(build, row)) ++offsets[task * partitions + partition_of(hashes[row])];
+        }
+    });
+    // Scatter rows so each partition is contiguous and keeps row order
+    std::vector<std::size_t> starts(partitions + 1);
+    std::size_t total = 0;
+    for (std::size_t p = 0; p < partitions; ++p) {
+        starts[p] = total;
+        for (std::size_t task = 0; task < build_tasks; ++task) {
+            const std::size_t count = offsets[task * partitions + p];
+            offsets[task * partitions + p] = total;
+            total += count;
+        }
     }
+    starts[partitions] = total;
+    std::vector<std::size_t> partitioned(total);
+    parallel_for(build_tasks, threads, [&](std::size_t task, unsigned) {
+        const std::size_t end = std::min(build_rows, (task + 1) * task_rows);
+        for (std::size_t row = task * task_rows; row < end; ++row) {
+            if (!has_null_key(build, row)) partitioned[offsets[task * partitions + partition_of(hashes[row])]++] = row;
+        }
+    });
+
+    // One open-addressing table per partition from each distinct key to
+    // the chain of its rows (positions in `partitioned`, linked by next)
+    constexpr std::size_t end_of_chain = std::numeric_limits<std::size_t>::max();
+    struct Slot {
+        std::uint64_t hash;
+        std::size_t head;
+    };
+    std::vector<std::vector<Slot>> tables(partitions);
+    std::vector<std::size_t> next(total);
+    parallel_for(partitions, threads, [&](std::size_t p, unsigned) {
+        std::size_t size = 16;
+        while (size < 2 * (starts[p + 1] - starts[p])) size *= 2;
+        std::vector<Slot>& slots = tables[p];
+        slots.assign(size, Slot{0, end_of_chain});
+        // Backwards, so that prepending leaves each chain in row order
+        for (std::size_t pos = starts[p + 1]; pos-- > starts[p];) {
+            const std::size_t row = partitioned[pos];
+            const std::uint64_t hash = hashes[row];
+            for (std::size_t i = hash & (size - 1);; i = (i + 1) & (size - 1)) {
+                Slot& slot = slots[i];
+                if (slot.head == end_of_chain) {
+                    slot = Slot{hash, pos};
+                    next[pos] = end_of_chain;
+                    break;
+                }
+                if (slot.hash == hash && compare_key_rows(build, partitioned[slot.head], build, row) == 0) {
+                    next[pos] = slot.head;
+                    slot.head = pos;
+                    break;
+                }
+            }
+        }
+    });
 
-    Eigen::VectorXd result(column.size());
-    for (size_t i = 0; i < column.size(); ++i) {
-        std::visit([&result, i](auto&& val) {
-            // Corrected: Ensure the extraction is properly casting numeric types
-            if constexpr (std::is_same_v<decltype(val), int> || std::is_same_v<decltype(val), double>) {
-                result[i] = static_cast<double>(val);  // Convert to double to ensure consistency
+    const std::size_t probe_tasks = (probe_rows + task_rows - 1) / task_rows;
+    std::vector<JoinIndices> found(probe_tasks);
+    parallel_for(probe_tasks, threads, [&](std::size_t task, unsigned) {
+        JoinIndices& out = found[task];
+        std::vector<std::uint64_t> chunk_hashes(expr_chunk_rows);
+        const std::size_t end = std::min(probe_rows, (task + 1) * task_rows);
+        for (std::size_t row0 = task * task_rows; row0 < end; row0 += expr_chunk_rows) {
+            const std::size_t n = std::min(expr_chunk_rows, end - row0);
+            hash_key_rows(probe, row0, n, chunk_hashes.data());
+            for (std::size_t k = 0; k < n; ++k) {
+                const std::size_t row = row0 + k;
+                const std::uint64_t hash = chunk_hashes[k];
+                const std::vector<Slot>& slots = tables[partition_of(hash)];
+                std::size_t head = end_of_chain;
+                if (!has_null_key(probe, row)) {
+                    for (std::size_t i = hash & (slots.size() - 1);; i = (i + 1) & (slots.size() - 1)) {
+                        if (slots[i].head == end_of_chain) break;
+                        if (slots[i].hash == hash && compare_key_rows(probe, row, build, partitioned[slots[i].head]) == 0) {
+                            head = slots[i].head;
+                            break;
+                        }
+                    }
+                }
+                for (std::size_t pos = head; pos != end_of_chain; pos = next[pos]) {
+                    out.first.push_back(row);
+                    out.second.push_back(partitioned[pos]);
+                }
+                if (head == end_of_chain && keep_unmatched) {
+                    out.first.push_back(row);
+                    out.second.push_back(null_row);
+                }
             }
-        }, column[i]);
+        }
+    });
+
+    JoinIndices pairs;
+    for (const JoinIndices& part : found) {
+        pairs.first.insert(pairs.first.end(), part.first.begin(), part.first.end());
+        pairs.second.insert(pairs.second.end(), part.second.begin(), part.second.end());
     }
-    return result;
+    return pairs;
 }
 
-// Combine numeric columns into a single Eigen matrix
-Eigen::MatrixXd build_numeric_matrix(const DataFrame& df) {
-    size_t num_rows = df.columns[0].size();
-    std::vector<Eigen::VectorXd> numeric_columns;
+// Sort-merge join of two sides already sorted on the keys: one pass over
+// each, pairing every run of equal left keys with the matching run of
+// right keys. Pairs come out in key order.
+JoinIndices merge_join(const std::vector<const Column*>& left, std::size_t left_rows,
+                       const std::vector<const Column*>& right, std::size_t right_rows, bool keep_unmatched) {
+    JoinIndices pairs;
+    std::size_t j = 0;
+    for (std::size_t i = 0; i < left_rows;) {
+        if (has_null_key(left, i)) {
+            if (keep_unmatched) {
+                pairs.first.push_back(i);
+                pairs.second.push_back(null_row);
+            }
+            ++i;
+            continue;
+        }
+        while (j < right_rows && compare_key_rows(left, i, right, j) > 0) ++j;
+        std::size_t j_end = j;
+        while (j_end < right_rows && compare_key_rows(left, i, right, j_end) == 0) ++j_end;
+        std::size_t i_end = i + 1;
+        while (i_end < left_rows && compare_key_rows(left, i_end, left, i) == 0) ++i_end;
+        for (; i < i_end; ++i) {
+            for (std::size_t r = j; r < j_end; ++r) {
+                pairs.first.push_back(i);
+                pairs.second.push_back(r);
+            }
+            if (j == j_end && keep_unmatched) {
+                pairs.first.push_back(i);
+                pairs.second.push_back(null_row);
+            }
+        }
+        j = j_end;
+    }
+    return pairs;
+}
+
+// Choose a join strategy: sort-merge when both sides are already sorted
+// on the keys (no table to build, and sequential access), a hash join
+// otherwise or when one side is small enough that checking the order of
+// both would cost more than hashing it
+JoinStrategy plan_join(const DataFrame& left, const DataFrame& right, const std::vector<std::string>& on,
+                       const JoinOptions& options = {}) {
+    if (options.strategy != JoinStrategy::automatic) return options.strategy;
+    if (std::min(left.row_count(), right.row_count()) < expr_chunk_rows) return JoinStrategy::hash;
+    return sorted_by_keys(key_columns(left, on), left.row_count(), options.threads) &&
+                   sorted_by_keys(key_columns(right, on), right.row_count(), options.threads)
+               ? JoinStrategy::sort_merge
+               : JoinStrategy::hash;
+}
 
-    // Extract all numeric columns
-    for (const auto& column : df.columns) {
-        if (is_numeric_column(column)) {
-            numeric_columns.push_back(extract_numeric_column(column));
+// Join left and right on the named key columns. The result holds every
+// left column, then the right columns other than the keys; its rows are
+// gathered from both sides through the matched row indices.
+DataFrame join(const DataFrame& left, const DataFrame& right, const std::vector<std::string>& on,
+               const JoinOptions& options = {}) {
+    if (on.empty()) throw std::invalid_argument("A join needs at least one key column.");
+    const std::vector<const Column*> left_keys = key_columns(left, on);
+    const std::vector<const Column*> right_keys = key_columns(right, on);
+    for (std::size_t c = 0; c < on.size(); ++c) {
+        if (left_keys[c]->is_numeric() != right_keys[c]->is_numeric()) {
+            throw std::invalid_argument("Join key '" + on[c] + "' holds numbers on one side and text on the other.");
         }
     }
 
-    if (numeric_columns.empty()) {
-        throw std::runtime_error("No numeric columns found in DataFrame.");
+    const bool keep_unmatched = options.type == JoinType::left;
+    const std::size_t left_rows = left.row_count(), right_rows = right.row_count();
+    JoinIndices rows;
+    if (plan_join(left, right, on, options) == JoinStrategy::sort_merge) {
+        rows = merge_join(left_keys, left_rows, right_keys, right_rows, keep_unmatched);
+    } else if (!keep_unmatched && right_rows > left_rows) {
+        // Inner join: build the table on the smaller side
+        JoinIndices swapped = hash_join(right_keys, right_rows, left_keys, left_rows, false, options.threads);
+        rows.first = std::move(swapped.second);
+        rows.second = std::move(swapped.first);
+    } else {
+        rows = hash_join(left_keys, left_rows, right_keys, right_rows, keep_unmatched, options.threads);
     }
 
-    // Create an Eigen matrix from the extracted numeric columns
-    Eigen::MatrixXd matrix(num_rows, numeric_columns.size());
-    for (size_t i = 0; i < numeric_columns.size(); ++i) {
-        matrix.col(i) = numeric_columns[i];
+    DataFrame out;
+    std::vector<std::pair<const Column*, const std::vector<std::size_t>*>> sources;
+    for (std::size_t c = 0; c < left.columns.size(); ++c) {
+        out.column_names.push_back(left.column_names[c]);
+        sources.emplace_back(&left.columns[c], &rows.first);
     }
+    for (std::size_t c = 0; c < right.columns.size(); ++c) {
+        const std::string& name = right.column_names[c];
+        if (std::find(on.begin(), on.end(), name) != on.end()) continue;
+        const bool clash = std::find(left.column_names.begin(), left.column_names.end(), name) != left.column_names.end();
+        out.column_names.push_back(clash ? name + options.suffix : name);
+        sources.emplace_back(&right.columns[c], &rows.second);
+    }
+    out.columns.resize(sources.size());
+    parallel_for(sources.size(), options.threads, [&](std::size_t c, unsigned) {
+        out.columns[c] = take(*sources[c].first, *sources[c].second);
+    });
+    return out;
+}
 
-    return matrix;
+/**************************************************************
+*             BINARY COLUMNAR FILES (MEMORY-MAPPED)           *
+**************************************************************/
+
+// File layout (little-endian):
+//   header     64 bytes: magic "DFCOLS01", u32 version, u32 column count,
+//              u64 row count, u64 directory offset, u64 directory bytes
+//   buffers    every buffer starts on a 64-byte boundary
+//   directory  per column: u32 name length, name, u8 type, u64 size,
+//              u64 null count, u8 has stats, stats, u64 dictionary size,
+//              then five buffer entries (values, offsets, validity,
+//              dictionary values, dictionary offsets), each u64 offset,
+//              u64 stored bytes, u64 decoded bytes, u8 codec
+// Stats are two int64s (int64 and char columns), two doubles (float64)
+// or two u32-length-prefixed strings (string and dictionary columns).
+// Uncompressed buffers are used in place from the mapping; compressed
+// ones are decoded when the file is opened.
+
+constexpr char column_file_magic[8] = {'D', 'F', 'C', 'O', 'L', 'S', '0', '1'};
+constexpr std::uint32_t column_file_version = 1;
+constexpr std::size_t column_file_header_bytes = 64;
+
+// raw: the bytes as they are in memory. delta_varint: 8-byte integers
+// stored as zigzag varints of their differences, which shrinks sorted
+// keys, dates and string offsets several-fold.
+enum class BufferCodec : std::uint8_t { raw, delta_varint };
+
+struct ColumnFileOptions {
+    bool compress = false;  // delta_varint int64 values and offsets where it pays off
+};
+
+// Smallest and largest non-null value of a column (NaN is skipped).
+// Which fields are set depends on the column type.
+struct ColumnStats {
+    bool present = false;
+    std::int64_t int_min = 0, int_max = 0;    // int64 and char
+    double real_min = 0, real_max = 0;        // float64
+    std::string text_min, text_max;           // string and dictionary
+};
+
+ColumnStats compute_stats(const Column& column) {
+    ColumnStats stats;
+    const std::size_t n = column.size();
+    switch (column.type()) {
+        case ColumnType::int64:
+        case ColumnType::character:
+            for (std::size_t row = 0; row < n; ++row) {
+                if (column.is_null(row)) continue;
+                const std::int64_t v = column.type() == ColumnType::int64 ? column.values<std::int64_t>()[row]
+                                                                          : column.values<char>()[row];
+                stats.int_min = stats.present ? std::min(stats.int_min, v) : v;
+                stats.int_max = stats.present ? std::max(stats.int_max, v) : v;
+                stats.present = true;
+            }
+            break;
+        case ColumnType::float64:
+            for (std::size_t row = 0; row < n; ++row) {
+                const double v = column.values<double>()[row];
+                if (column.is_null(row) || std::isnan(v)) continue;
+                stats.real_min = stats.present ? std::min(stats.real_min, v) : v;
+                stats.real_max = stats.present ? std::max(stats.real_max, v) : v;
+                stats.present = true;
+            }
+            break;
+        default: {
+            std::string_view lo, hi;
+            for (std::size_t row = 0; row < n; ++row) {
+                if (column.is_null(row)) continue;
+                const std::string_view v = column.string_at(row);
+                if (!stats.present || v < lo) lo = v;
+                if (!stats.present || v > hi) hi = v;
+                stats.present = true;
+            }
+            stats.text_min = lo;
+            stats.text_max = hi;
+        }
+    }
+    return stats;
 }
 
-// Function to perform element-wise multiplication on numeric columns
-Eigen::MatrixXd elementwise_multiply(const DataFrame& df1, const DataFrame& df2) {
-    // Build matrices from both DataFrames
-    Eigen::MatrixXd matrix1 = build_numeric_matrix(df1);
-    Eigen::MatrixXd matrix2 = build_numeric_matrix(df2);
+template <typename T>
+void put_bytes(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof value);
+}
 
-    if (matrix1.rows() != matrix2.rows() || matrix1.cols() != matrix2.cols()) {
-        throw std::invalid_argument("Matrices must have the same dimensions for element-wise multiplication.");
+void put_text(std::string& out, std::string_view text) {
+    put_bytes(out, static_cast<std::uint32_t>(text.size()));
+    out.append(text.data(), text.size());
+}
+
+// Bounds-checked reads from a byte range; a short range means a
+// truncated or corrupt file
+class ByteReader {
+public:
+    ByteReader(const char* data, std::size_t size) : data_(data), size_(size) {}
+
+    template <typename T>
+    T get() {
+        T value;
+        std::memcpy(&value, take(sizeof value), sizeof value);
+        return value;
+    }
+
+    std::string_view get_text() {
+        const std::uint32_t n = get<std::uint32_t>();
+        return std::string_view(take(n), n);
+    }
+
+private:
+    const char* take(std::size_t n) {
+        if (n > size_ - pos_) throw std::runtime_error("Column file is truncated or corrupt.");
+        const char* p = data_ + pos_;
+        pos_ += n;
+        return p;
+    }
+
+    const char* data_;
+    std::size_t size_;
+    std::size_t pos_ = 0;
+};
+
+std::string encode_delta_varint(const std::int64_t* values, std::size_t count) {
+    std::string out;
+    std::uint64_t previous = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        const std::uint64_t v = static_cast<std::uint64_t>(values[i]);
+        const std::int64_t delta = static_cast<std::int64_t>(v - previous);
+        std::uint64_t zigzag = (static_cast<std::uint64_t>(delta) << 1) ^ static_cast<std::uint64_t>(delta >> 63);
+        previous = v;
+        while (zigzag >= 0x80) {
+            out.push_back(static_cast<char>(zigzag | 0x80));
+            zigzag >>= 7;
+        }
+        out.push_back(static_cast<char>(zigzag));
+    }
+    return out;
+}
+
+Buffer decode_delta_varint(const char* data, std::size_t bytes, std::size_t decoded_bytes) {
+    if (decoded_bytes % sizeof(std::int64_t) != 0) throw std::runtime_error("Column file is truncated or corrupt.");
+    AlignedVector<std::int64_t> values(decoded_bytes / sizeof(std::int64_t));
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* end = p + bytes;
+    std::uint64_t previous = 0;
+    for (std::int64_t& value : values) {
+        std::uint64_t zigzag = 0;
+        for (unsigned shift = 0;; shift += 7) {
+            if (p == end || shift > 63) throw std::runtime_error("Column file is truncated or corrupt.");
+            zigzag |= static_cast<std::uint64_t>(*p & 0x7f) << shift;
+            if (!(*p++ & 0x80)) break;
+        }
+        const std::uint64_t delta = (zigzag >> 1) ^ (~(zigzag & 1) + 1);
+        previous += delta;
+        value = static_cast<std::int64_t>(previous);
+    }
+    return Buffer::adopt(std::move(values));
+}
+
+// Write a frame as a column file. The file is written next to `path`
+// and renamed over it once complete.
+void write_column_file(const DataFrame& df, const std::string& path, ColumnFileOptions options = {}) {
+    const std::string temp = path + ".tmp";
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("Cannot create " + temp + ": " + std::strerror(errno));
+    std::uint64_t position = column_file_header_bytes;
+    out.write(std::string(column_file_header_bytes, '\0').data(), column_file_header_bytes);
+
+    std::string directory;
+    // Append one buffer on a 64-byte boundary and its directory entry.
+    // Buffers of 8-byte integers may be stored delta_varint-encoded.
+    const auto write_buffer = [&](const char* data, std::size_t bytes, bool integers) {
+        std::string encoded;
+        BufferCodec codec = BufferCodec::raw;
+        if (options.compress && integers && bytes > 0) {
+            encoded = encode_delta_varint(reinterpret_cast<const std::int64_t*>(data), bytes / sizeof(std::int64_t));
+            if (encoded.size() < bytes) codec = BufferCodec::delta_varint;
+        }
+        const char* stored = codec == BufferCodec::raw ? data : encoded.data();
+        const std::size_t stored_bytes = codec == BufferCodec::raw ? bytes : encoded.size();
+        const std::uint64_t padding = (buffer_alignment - position % buffer_alignment) % buffer_alignment;
+        out.write(std::string(padding, '\0').data(), static_cast<std::streamsize>(padding));
+        position += padding;
+        put_bytes(directory, position);
+        put_bytes(directory, static_cast<std::uint64_t>(stored_bytes));
+        put_bytes(directory, static_cast<std::uint64_t>(bytes));
+        put_bytes(directory, codec);
+        if (stored_bytes > 0) out.write(stored, static_cast<std::streamsize>(stored_bytes));
+        position += stored_bytes;
+    };
+    // Strings as (bytes, offsets) with offsets rebased to start at 0
+    const auto write_strings = [&](const Column& strings) {
+        const std::size_t n = strings.size();
+        const std::uint64_t* offsets = strings.offset_buffer().as<std::uint64_t>();
+        const std::uint64_t first = offsets[0];
+        write_buffer(strings.value_buffer().as<char>() + first, offsets[n] - first, false);
+        AlignedVector<std::uint64_t> rebased(n + 1);
+        for (std::size_t i = 0; i <= n; ++i) rebased[i] = offsets[i] - first;
+        write_buffer(reinterpret_cast<const char*>(rebased.data()), rebased.size() * sizeof(std::uint64_t), true);
+    };
+
+    for (std::size_t c = 0; c < df.columns.size(); ++c) {
+        const Column& column = df.columns[c];
+        const std::size_t n = column.size();
+        put_text(directory, df.column_names[c]);
+        put_bytes(directory, column.type());
+        put_bytes(directory, static_cast<std::uint64_t>(n));
+        put_bytes(directory, static_cast<std::uint64_t>(column.null_count()));
+
+        const ColumnStats stats = compute_stats(column);
+        put_bytes(directory, static_cast<std::uint8_t>(stats.present));
+        if (stats.present) {
+            switch (column.type()) {
+                case ColumnType::int64:
+                case ColumnType::character:
+                    put_bytes(directory, stats.int_min);
+                    put_bytes(directory, stats.int_max);
+                    break;
+                case ColumnType::float64:
+                    put_bytes(directory, stats.real_min);
+                    put_bytes(directory, stats.real_max);
+                    break;
+                default:
+                    put_text(directory, stats.text_min);
+                    put_text(directory, stats.text_max);
+            }
+        }
+        const bool dictionary = column.type() == ColumnType::dictionary;
+        put_bytes(directory, static_cast<std::uint64_t>(dictionary ? column.dictionary()->size() : 0));
+
+        const std::size_t validity_bytes = column.null_count() > 0 ? (n + 63) / 64 * sizeof(std::uint64_t) : 0;
+        switch (column.type()) {
+            case ColumnType::string: write_strings(column); break;
+            case ColumnType::dictionary:
+                write_buffer(column.value_buffer().as<char>(), n * sizeof(std::int32_t), false);
+                write_buffer(nullptr, 0, false);
+                break;
+            default: {
+                const std::size_t width = column.type() == ColumnType::character ? 1 : 8;
+                write_buffer(column.value_buffer().as<char>(), n * width, column.type() == ColumnType::int64);
+                write_buffer(nullptr, 0, false);
+            }
+        }
+        write_buffer(column.validity_buffer().as<char>(), validity_bytes, false);
+        if (dictionary) {
+            write_strings(column.dictionary()->values);
+        } else {
+            write_buffer(nullptr, 0, false);
+            write_buffer(nullptr, 0, false);
+        }
     }
 
-    // Perform element-wise multiplication
-    return matrix1.array() * matrix2.array();
+    const std::uint64_t directory_offset = position;
+    out.write(directory.data(), static_cast<std::streamsize>(directory.size()));
+    std::string header;
+    header.append(column_file_magic, sizeof column_file_magic);
+    put_bytes(header, column_file_version);
+    put_bytes(header, static_cast<std::uint32_t>(df.columns.size()));
+    put_bytes(header, static_cast<std::uint64_t>(df.row_count()));
+    put_bytes(header, directory_offset);
+    put_bytes(header, static_cast<std::uint64_t>(directory.size()));
+    out.seekp(0);
+    out.write(header.data(), static_cast<std::streamsize>(header.size()));
+    out.close();
+    if (!out) throw std::runtime_error("Cannot write " + temp + ".");
+    if (std::rename(temp.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Cannot rename " + temp + " to " + path + ": " + std::strerror(errno));
+    }
 }
 
+// An open column file. Opening maps the file and reads only the header
+// and directory; the frame's columns are views into the mapping (which
+// they keep alive), so their pages are read on first touch. The open
+// checks what it can in constant time per column (buffer sizes, the ends
+// of the string offsets); string offsets and dictionary codes in between
+// are bounds-checked as rows are read, so opening never pages in a column.
+class ColumnFile {
+public:
+    explicit ColumnFile(const std::string& path) : file_(std::make_shared<MappedFile>(path)) {
+        ByteReader header(file_->data(), file_->size());
+        char magic[sizeof column_file_magic];
+        for (char& m : magic) m = header.get<char>();
+        if (!std::equal(magic, magic + sizeof magic, column_file_magic)) {
+            throw std::runtime_error(path + " is not a column file.");
+        }
+        if (header.get<std::uint32_t>() != column_file_version) {
+            throw std::runtime_error(path + " has an unsupported column file version.");
+        }
+        const std::uint32_t columns = header.get<std::uint32_t>();
+        const std::uint64_t rows = header.get<std::uint64_t>();
+        const std::uint64_t directory_offset = header.get<std::uint64_t>();
+        const std::uint64_t directory_bytes = header.get<std::uint64_t>();
+        if (directory_offset > file_->size() || directory_bytes > file_->size() - directory_offset) {
+            throw std::runtime_error("Column file is truncated or corrupt.");
+        }
+
+        ByteReader directory(file_->data() + directory_offset, directory_bytes);
+        for (std::uint32_t c = 0; c < columns; ++c) {
+            const std::string name(directory.get_text());
+            const ColumnType type = directory.get<ColumnType>();
+            if (type > ColumnType::dictionary) throw std::runtime_error("Column file is truncated or corrupt.");
+            const std::uint64_t size = directory.get<std::uint64_t>();
+            const std::uint64_t null_count = directory.get<std::uint64_t>();
+            if (size != rows || null_count > size) throw std::runtime_error("Column file is truncated or corrupt.");
+
+            ColumnStats stats;
+            stats.present = directory.get<std::uint8_t>() != 0;
+            if (stats.present) {
+                switch (type) {
+                    case ColumnType::int64:
+                    case ColumnType::character:
+                        stats.int_min = directory.get<std::int64_t>();
+                        stats.int_max = directory.get<std::int64_t>();
+                        break;
+                    case ColumnType::float64:
+                        stats.real_min = directory.get<double>();
+                        stats.real_max = directory.get<double>();
+                        break;
+                    default:
+                        stats.text_min = directory.get_text();
+                        stats.text_max = directory.get_text();
+                }
+            }
+            const std::uint64_t dictionary_size = directory.get<std::uint64_t>();
+            Buffer buffers[5];
+            for (Buffer& buffer : buffers) buffer = read_buffer(directory);
+
+            check_buffers(type, size, null_count, dictionary_size, buffers);
+            Column column;
+            if (type == ColumnType::dictionary) {
+                auto dictionary = std::make_shared<Dictionary>();
+                dictionary->values = Column::from_buffers(ColumnType::string, dictionary_size, buffers[3], buffers[4]);
+                dictionary->hashes.resize(dictionary_size);
+                for (std::size_t i = 0; i < dictionary_size; ++i) {
+                    dictionary->hashes[i] = std::hash<std::string_view>()(dictionary->values.string_at(i));
+                }
+                column = Column::from_dictionary(size, buffers[0], std::move(dictionary), buffers[2], null_count);
+            } else {
+                column = Column::from_buffers(type, size, buffers[0], buffers[1], buffers[2], null_count);
+            }
+            add_column(frame_, name, std::move(column));
+            stats_.push_back(std::move(stats));
+        }
+    }
+
+    // Columns viewing the file (copies share the mapping)
+    const DataFrame& frame() const { return frame_; }
+    const ColumnStats& stats(std::size_t column) const { return stats_.at(column); }
+
+private:
+    [[noreturn]] static void corrupt() { throw std::runtime_error("Column file is truncated or corrupt."); }
+
+    // Strings [0, size) must start at offset 0 and end inside the value
+    // bytes; with `every_offset` the offsets in between are checked too
+    static void check_string_offsets(std::uint64_t size, const Buffer& values, const Buffer& offsets,
+                                     bool every_offset) {
+        if (size >= offsets.size() / sizeof(std::uint64_t)) corrupt();
+        const std::uint64_t* offset = offsets.as<std::uint64_t>();
+        if (offset[0] != 0 || offset[size] > values.size()) corrupt();
+        for (std::uint64_t i = 0; every_offset && i < size; ++i) {
+            if (offset[i + 1] < offset[i]) corrupt();
+        }
+    }
+
+    // Every buffer must cover the rows the column reads from it. The
+    // dictionary is checked in full, as it is hashed on open anyway.
+    static void check_buffers(ColumnType type, std::uint64_t size, std::uint64_t null_count,
+                              std::uint64_t dictionary_size, const Buffer (&buffers)[5]) {
+        if (null_count > 0 && buffers[2].size() / sizeof(std::uint64_t) < (size + 63) / 64) corrupt();
+        switch (type) {
+            case ColumnType::string: check_string_offsets(size, buffers[0], buffers[1], false); break;
+            case ColumnType::character:
+                if (buffers[0].size() < size) corrupt();
+                break;
+            case ColumnType::dictionary:
+                if (dictionary_size > static_cast<std::uint64_t>(std::numeric_limits<std::int32_t>::max()) ||
+                    buffers[0].size() / sizeof(std::int32_t) < size) {
+                    corrupt();
+                }
+                check_string_offsets(dictionary_size, buffers[3], buffers[4], true);
+                break;
+            default:
+                if (buffers[0].size() / 8 < size) corrupt();
+        }
+    }
+
+    Buffer read_buffer(ByteReader& directory) const {
+        const std::uint64_t offset = directory.get<std::uint64_t>();
+        const std::uint64_t stored = directory.get<std::uint64_t>();
+        const std::uint64_t decoded = directory.get<std::uint64_t>();
+        const BufferCodec codec = directory.get<BufferCodec>();
+        if (offset > file_->size() || stored > file_->size() - offset) corrupt();
+        const char* data = file_->data() + offset;
+        switch (codec) {
+            case BufferCodec::raw:
+                // Mapped buffers are read in place, so they keep the writer's alignment
+                if (stored != decoded || offset % buffer_alignment != 0) corrupt();
+                return Buffer::view(data, stored, file_);
+            case BufferCodec::delta_varint: return decode_delta_varint(data, stored, decoded);
+            default: throw std::runtime_error("Column file uses an unknown codec.");
+        }
+    }
+
+    std::shared_ptr<MappedFile> file_;
+    DataFrame frame_;
+    std::vector<ColumnStats> stats_;
+};
+
+// Open a column file and return its frame (see ColumnFile)
+DataFrame read_column_file(const std::string& path) { return ColumnFile(path).frame(); }
+
 /**************************************************************
 *                         MAIN FUNCTION                       *
 **************************************************************/
 
-int main() {
+// Load a CSV file (in batches of batch_mb MiB if given) and describe it
+int describe_csv(const std::string& path, const CsvOptions& options) {
+    const auto start = std::chrono::steady_clock::now();
+    CsvReader reader(path, options);
+    std::size_t rows = 0, batches = 0, peak_bytes = 0;
+    std::optional<DataFrame> last;
+    while (auto batch = reader.next_batch()) {
+        rows += batch->row_count();
+        ++batches;
+        peak_bytes = std::max(peak_bytes, memory_bytes(*batch));
+        last = std::move(batch);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << path << ": " << rows << " rows in " << batches << " batch(es), " << elapsed.count() << " s\n";
+    for (std::size_t c = 0; c < reader.column_names().size(); ++c) {
+        std::cout << "  " << reader.column_names()[c] << ": "
+                  << (last ? column_type_name(last->columns[c].type()) : "empty") << "\n";
+    }
+    std::cout << "Largest batch holds " << peak_bytes << " bytes of column data\n";
+    return EXIT_SUCCESS;
+}
+
+// Open a column file and describe its columns and stats
+int describe_column_file(const std::string& path) {
+    const auto start = std::chrono::steady_clock::now();
+    ColumnFile file(path);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const DataFrame& df = file.frame();
+    std::cout << path << ": " << df.row_count() << " rows, opened in " << elapsed.count() << " s\n";
+    for (std::size_t c = 0; c < df.columns.size(); ++c) {
+        const ColumnStats& stats = file.stats(c);
+        std::cout << "  " << df.column_names[c] << ": " << column_type_name(df.columns[c].type()) << ", "
+                  << df.columns[c].null_count() << " nulls";
+        if (stats.present) {
+            std::cout << ", range ";
+            switch (df.columns[c].type()) {
+                case ColumnType::int64: std::cout << stats.int_min << " .. " << stats.int_max; break;
+                case ColumnType::character:
+                    std::cout << static_cast<char>(stats.int_min) << " .. " << static_cast<char>(stats.int_max);
+                    break;
+                case ColumnType::float64: std::cout << stats.real_min << " .. " << stats.real_max; break;
+                default: std::cout << stats.text_min << " .. " << stats.text_max;
+            }
+        }
+        std::cout << "\n";
+    }
+    return EXIT_SUCCESS;
+}
+
+// Comma-separated items of a command-line value
+std::vector<std::string> split_list(const std::string& text) {
+    std::vector<std::string> items;
+    std::size_t begin = 0;
+    for (std::size_t comma; (comma = text.find(',', begin)) != std::string::npos; begin = comma + 1) {
+        items.push_back(text.substr(begin, comma - begin));
+    }
+    items.push_back(text.substr(begin));
+    return items;
+}
+
+// Stream a CSV file through a group-by and print the groups.
+// Aggregations are given as op:column (e.g. mean:price).
+int group_csv(const std::string& path, const CsvOptions& options, const std::vector<std::string>& keys,
+              const std::vector<std::string>& aggregates) {
+    std::vector<Aggregation> aggregations;
+    for (const std::string& item : aggregates) {
+        const std::size_t colon = item.find(':');
+        if (colon == std::string::npos) throw std::invalid_argument("Aggregates are given as op:column, not " + item + ".");
+        Aggregation aggregation;
+        aggregation.op = parse_aggregate(item.substr(0, colon));
+        aggregation.column = item.substr(colon + 1);
+        aggregations.push_back(aggregation);
+    }
+    const auto start = std::chrono::steady_clock::now();
+    CsvReader reader(path, options);
+    GroupBy grouping(keys, aggregations, options.threads);
+    std::size_t rows = 0;
+    while (auto batch = reader.next_batch()) {
+        rows += batch->row_count();
+        grouping.add(*batch);
+    }
+    const DataFrame groups = grouping.result();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    print_dataframe(groups);
+    std::cout << groups.row_count() << " groups from " << rows << " rows in " << elapsed.count() << " s\n";
+    return EXIT_SUCCESS;
+}
+
+// Test programs define DATAFRAME_NO_MAIN and include this file for its API
+#ifndef DATAFRAME_NO_MAIN
+int main(int argc, char** argv) {
+    // dataFrames FILE.csv [--threads=N] [--batch-mb=N] [--delimiter=C] [--no-header] [--categorical]
+    //            [--group-by=KEY,... [--aggregate=OP:COLUMN,...]] [--save=FILE.dfc [--compress]]
+    // loads and describes (groups, or saves as a column file) a CSV file,
+    // and dataFrames FILE.dfc describes a column file, instead of running
+    // the example
+    if (argc > 1) {
+        try {
+            CsvOptions options;
+            std::string path;
+            std::vector<std::string> keys, aggregates;
+            std::string save_path;
+            ColumnFileOptions file_options;
+            for (int a = 1; a < argc; ++a) {
+                const std::string arg = argv[a];
+                if (arg.rfind("--threads=", 0) == 0) options.threads = std::stoul(arg.substr(10));
+                else if (arg.rfind("--group-by=", 0) == 0) keys = split_list(arg.substr(11));
+                else if (arg.rfind("--aggregate=", 0) == 0) aggregates = split_list(arg.substr(12));
+                else if (arg.rfind("--batch-mb=", 0) == 0) options.batch_bytes = std::stoul(arg.substr(11)) << 20;
+                else if (arg.rfind("--delimiter=", 0) == 0 && arg.size() == 13) options.delimiter = arg[12];
+                else if (arg == "--no-header") options.header = false;
+                else if (arg == "--categorical") options.categorical = true;
+                else if (arg.rfind("--save=", 0) == 0) save_path = arg.substr(7);
+                else if (arg == "--compress") file_options.compress = true;
+                else path = arg;
+            }
+            if (path.size() > 4 && path.compare(path.size() - 4, 4, ".dfc") == 0) return describe_column_file(path);
+            if (!keys.empty()) return group_csv(path, options, keys, aggregates);
+            if (!save_path.empty()) {
+                write_column_file(read_csv(path, options), save_path, file_options);
+                return describe_column_file(save_path);
+            }
+            return describe_csv(path, options);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
     /*
         Initialize two DataFrames with numeric data types:
         ------------------------------------------------
@@ -176,6 +3437,11 @@ int main() {
         print_dataframe(df2);
         std::cout << "--------------------------------------------\n";
 
+        // Typed storage: 8 bytes per numeric cell instead of a variant each
+        std::cout << "\nColumn storage of DataFrame 1: " << memory_bytes(df1) << " bytes for "
+                  << df1.row_count() * df1.columns.size() << " cells (" << sizeof(DataFrameElement)
+                  << " bytes per variant cell)\n";
+
         // Perform an element-wise multiplication similar to NumPy
         std::cout << "\nPerforming element-wise multiplication...\n";
         Eigen::MatrixXd result_matrix = elementwise_multiply(df1, df2);
@@ -183,6 +3449,25 @@ int main() {
         // Output the result matrix
         std::cout << "Resulting Matrix after element-wise multiplication:\n" << result_matrix << std::endl;
 
+        // The same kind of arithmetic as a lazy expression, evaluated in
+        // one pass, and a filter
+        std::cout << "\nLazy expression Integers * Doubles + 2.0 over DataFrame 1:\n";
+        DataFrame derived;
+        add_column(derived, "Result", df1["Integers"] * df1["Doubles"] + 2.0);
+        print_dataframe(derived);
+        std::cout << "\nRows of DataFrame 2 where Doubles > 2.5:\n";
+        print_dataframe(filter(df2, df2["Doubles"] > 2.5));
+
+        // Categorical strings are stored as int32 codes into one table of
+        // distinct values; filters on them compare codes
+        DataFrame holdings;
+        add_categorical_column(holdings, "Sector", {std::string("Tech"), std::string("Energy"), std::string("Tech"),
+                                                    std::string("Energy"), std::string("Tech")});
+        add_column(holdings, "Weight", {0.25, 0.125, 0.25, 0.25, 0.125});
+        std::cout << "\nWeight per sector (Sector is " << column_type_name(holdings.columns[0].type()) << "):\n";
+        print_dataframe(group_by(holdings, {"Sector"}, {{"Weight", Aggregate::sum, ""}}));
+        std::cout << "Tech positions: " << filter(holdings, holdings["Sector"] == "Tech").row_count() << "\n";
+
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return EXIT_FAILURE;
@@ -190,3 +3475,4 @@ int main() {
 
     return EXIT_SUCCESS;
 }
+#endif  // DATAFRAME_NO_MAIN
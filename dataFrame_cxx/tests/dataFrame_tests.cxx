@@ -0,0 +1,653 @@
+// Regression tests for the DataFrame, run by ctest. dataFrame.cxx is a
+// single translation unit, so it is included here with its main() left
+// out. Expressions, joins and group-bys are checked against naive loops
+// over the same rows; CSV batches and column files against a single
+// in-memory read.
+#define DATAFRAME_NO_MAIN
+#include "../dataFrame.cxx"
+
+#include <functional>
+#include <map>
+#include <random>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), {});
+}
+
+void write_file(const std::string& path, const std::string& bytes) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+}
+
+// Same column names, and cell for cell the same values and nulls. With
+// `same_types` the column types must match too (a dictionary column does
+// not equal its decoded string column).
+bool same_frame(const DataFrame& a, const DataFrame& b, bool same_types = true) {
+    if (a.column_names != b.column_names || a.row_count() != b.row_count()) return false;
+    for (std::size_t c = 0; c < a.columns.size(); ++c) {
+        if (same_types && a.columns[c].type() != b.columns[c].type()) return false;
+        for (std::size_t row = 0; row < a.row_count(); ++row) {
+            if (!(key_value(a.columns[c], row) == key_value(b.columns[c], row))) return false;
+        }
+    }
+    return true;
+}
+
+// Rows of int64 keys in [0, key_range), one in twenty null, and an `id`
+// column numbering the rows. Sorted frames hold their keys in KeyValue
+// order (nulls last), as a sort-merge join expects.
+DataFrame keyed_frame(std::size_t rows, std::int64_t key_range, const std::string& id, std::uint64_t seed,
+                      bool sorted) {
+    std::mt19937_64 rng(seed);
+    std::vector<std::int64_t> keys(rows);
+    for (std::int64_t& k : keys) k = rng() % 20 == 0 ? -1 : static_cast<std::int64_t>(rng() % key_range);
+    if (sorted) {
+        std::sort(keys.begin(), keys.end(), [](std::int64_t x, std::int64_t y) {
+            return x != -1 && (y == -1 || x < y);
+        });
+    }
+    ColumnBuilder k(ColumnType::int64, rows), ids(ColumnType::int64, rows);
+    for (std::size_t row = 0; row < rows; ++row) {
+        if (keys[row] < 0) k.append_null();
+        else k.append_int64(keys[row]);
+        ids.append_int64(static_cast<std::int64_t>(row));
+    }
+    DataFrame df;
+    add_column(df, "k", k.finish());
+    add_column(df, id, ids.finish());
+    return df;
+}
+
+// (left id, right id) of every joined row, right id -1 for a null
+using RowPairs = std::vector<std::pair<std::int64_t, std::int64_t>>;
+
+RowPairs joined_pairs(const DataFrame& joined) {
+    const Column& left = joined.columns[column_index(joined, "id")];
+    const Column& right = joined.columns[column_index(joined, "rid")];
+    RowPairs pairs;
+    for (std::size_t row = 0; row < joined.row_count(); ++row) {
+        pairs.emplace_back(left.values<std::int64_t>()[row],
+                           right.is_null(row) ? -1 : right.values<std::int64_t>()[row]);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    return pairs;
+}
+
+RowPairs naive_join(const DataFrame& left, const DataFrame& right, JoinType type) {
+    const Column& lk = left.columns[0];
+    const Column& rk = right.columns[0];
+    RowPairs pairs;
+    for (std::size_t l = 0; l < left.row_count(); ++l) {
+        bool matched = false;
+        for (std::size_t r = 0; r < right.row_count() && !lk.is_null(l); ++r) {
+            if (!rk.is_null(r) && key_value(lk, l) == key_value(rk, r)) {
+                pairs.emplace_back(static_cast<std::int64_t>(l), static_cast<std::int64_t>(r));
+                matched = true;
+            }
+        }
+        if (!matched && type == JoinType::left) pairs.emplace_back(static_cast<std::int64_t>(l), -1);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    return pairs;
+}
+
+// Hash and sort-merge joins give the naive nested loop's row pairs
+void test_joins() {
+    const DataFrame left = keyed_frame(3000, 800, "id", 1, true);
+    const DataFrame right = keyed_frame(2500, 800, "rid", 2, true);
+    check(sorted_by_keys(key_columns(left, {"k"}), left.row_count()), "sorted join input");
+    for (JoinType type : {JoinType::inner, JoinType::left}) {
+        const std::string name = type == JoinType::inner ? "inner" : "left";
+        const RowPairs expected = naive_join(left, right, type);
+        for (JoinStrategy strategy : {JoinStrategy::hash, JoinStrategy::sort_merge}) {
+            for (unsigned threads : {1u, 4u}) {
+                const DataFrame joined = join(left, right, {"k"}, JoinOptions{type, strategy, threads, "_right"});
+                check(joined_pairs(joined) == expected, name + " " + join_strategy_name(strategy) + " join on " +
+                                                            std::to_string(threads) + " threads");
+            }
+        }
+    }
+
+    const DataFrame unsorted_left = keyed_frame(3000, 500, "id", 3, false);
+    const DataFrame unsorted_right = keyed_frame(1500, 500, "rid", 4, false);
+    for (JoinType type : {JoinType::inner, JoinType::left}) {
+        const DataFrame joined = join(unsorted_left, unsorted_right, {"k"}, JoinOptions{type});
+        check(joined_pairs(joined) == naive_join(unsorted_left, unsorted_right, type), "join of unsorted frames");
+    }
+}
+
+struct KeyLess {
+    bool operator()(const std::pair<KeyValue, KeyValue>& a, const std::pair<KeyValue, KeyValue>& b) const {
+        if (a.first < b.first) return true;
+        if (b.first < a.first) return false;
+        return a.second < b.second;
+    }
+};
+
+// Parallel group-by sums, sample variances and counts match a naive
+// per-group pass, for plain and dictionary-encoded string keys
+void test_group_by() {
+    const std::size_t rows = 20000;
+    const char* names[] = {"red", "green", "blue", ""};
+    std::mt19937_64 rng(5);
+    std::normal_distribution<double> noise(0.0, 1000.0);
+    ColumnBuilder k(ColumnType::int64, rows), s(ColumnType::string, rows), v(ColumnType::float64, rows);
+    for (std::size_t row = 0; row < rows; ++row) {
+        if (rng() % 16 == 0) k.append_null();
+        else k.append_int64(static_cast<std::int64_t>(rng() % 40));
+        if (rng() % 16 == 0) s.append_null();
+        else s.append_string(names[rng() % 4]);
+        // Large offset: a naive sum of squares would cancel
+        if (rng() % 10 == 0) v.append_null();
+        else v.append_double(1e6 + noise(rng));
+    }
+    DataFrame df;
+    add_column(df, "k", k.finish());
+    add_column(df, "s", s.finish());
+    add_column(df, "v", v.finish());
+
+    std::map<std::pair<KeyValue, KeyValue>, std::vector<double>, KeyLess> groups;
+    const Column& values = df.columns[2];
+    for (std::size_t row = 0; row < rows; ++row) {
+        std::vector<double>& group = groups[{key_value(df.columns[0], row), key_value(df.columns[1], row)}];
+        if (!values.is_null(row)) group.push_back(values.values<double>()[row]);
+    }
+
+    const std::vector<Aggregation> aggregations{{"v", Aggregate::sum, ""}, {"v", Aggregate::variance, ""},
+                                                {"v", Aggregate::count, ""}};
+    const DataFrame result = group_by(df, {"k", "s"}, aggregations, 4);
+    check(result.row_count() == groups.size(), "one group-by row per distinct key");
+    check(sorted_by_keys(key_columns(result, {"k", "s"}), result.row_count()), "groups sorted by key");
+    const auto close = [](double x, double y) { return std::fabs(x - y) <= 1e-9 * std::max(1.0, std::fabs(y)); };
+    std::size_t row = 0;
+    for (const auto& [key, group] : groups) {
+        if (row >= result.row_count()) break;
+        check(key_value(result.columns[0], row) == key.first && key_value(result.columns[1], row) == key.second,
+              "group key in row " + std::to_string(row));
+        double sum = 0;
+        for (double x : group) sum += x;
+        const double mean = group.empty() ? 0 : sum / static_cast<double>(group.size());
+        double m2 = 0;
+        for (double x : group) m2 += (x - mean) * (x - mean);
+        const Column& sums = result.columns[2];
+        const Column& variances = result.columns[3];
+        const Column& counts = result.columns[4];
+        check(group.empty() ? sums.is_null(row) : close(sums.values<double>()[row], sum),
+              "group sum in row " + std::to_string(row));
+        check(group.size() < 2 ? variances.is_null(row)
+                               : close(variances.values<double>()[row], m2 / static_cast<double>(group.size() - 1)),
+              "group variance in row " + std::to_string(row));
+        check(counts.values<std::int64_t>()[row] == static_cast<std::int64_t>(group.size()),
+              "group count in row " + std::to_string(row));
+        ++row;
+    }
+
+    DataFrame categorical = df;
+    categorical.columns[1] = encode_dictionary(df.columns[1]);
+    check(same_frame(group_by(categorical, {"k", "s"}, aggregations, 4), result, false),
+          "group-by on a dictionary key matches the string key");
+    check(same_frame(group_by(df, {"k", "s"}, aggregations, 1), result, false),
+          "group-by on one thread matches four");
+}
+
+// Same value, or both NaN
+bool same_number(double x, double y) { return x == y || (std::isnan(x) && std::isnan(y)); }
+
+// Adjacent float64 columns read as one block; other numeric columns go
+// through per-column views, with int64 nulls as NaN, and both give the
+// element-wise product of a naive loop
+void test_numeric_views() {
+    const std::size_t rows = 1001;
+    Eigen::MatrixXd values(rows, 3);
+    for (std::size_t row = 0; row < rows; ++row) {
+        for (Eigen::Index c = 0; c < 3; ++c) values(static_cast<Eigen::Index>(row), c) = row * 0.5 - 7.0 * c;
+    }
+    DataFrame block;
+    add_numeric_block(block, {"a", "b", "c"}, values);
+    const auto view = numeric_block_view(block, {0, 1, 2});
+    check(view && view->data() == block.columns[0].values<double>() &&
+              block.columns[2].values<double>() == view->data() + 2 * view->outerStride(),
+          "adjacent block columns give one strided view");
+    check(view && *view == values, "block view holds the columns' values");
+
+    ColumnBuilder ints(ColumnType::int64, rows), reals(ColumnType::float64, rows), more(ColumnType::float64, rows);
+    for (std::size_t row = 0; row < rows; ++row) {
+        if (row % 7 == 3) ints.append_null();
+        else ints.append_int64(static_cast<std::int64_t>(row) - 500);
+        reals.append_double(row * 0.25);
+        more.append_double(1.0 - row);
+    }
+    DataFrame loose;
+    add_column(loose, "i", ints.finish());
+    add_column(loose, "x", reals.finish());
+    add_column(loose, "s", Column::from_elements(DataFrameColumn(rows, std::string("text"))));
+    add_column(loose, "y", more.finish());
+    check(!numeric_block_view(loose, {0, 1, 3}), "an int64 column has no block view");
+
+    bool nulls_nan = true;
+    with_numeric_view(loose.columns[0], [&](const auto& column) {
+        for (std::size_t row = 0; row < rows; ++row) {
+            const double x = column[static_cast<Eigen::Index>(row)];
+            nulls_nan = nulls_nan && (row % 7 == 3 ? std::isnan(x) : x == static_cast<double>(row) - 500);
+        }
+    });
+    check(nulls_nan, "int64 view reads nulls as NaN");
+
+    DataFrame packed = loose;
+    pack_numeric_columns(packed);
+    const auto packed_view = numeric_block_view(packed, {1, 3});
+    check(packed_view && same_frame(packed, loose), "packed float64 columns form a block with the same values");
+    pack_numeric_columns(packed);
+    check(packed_view && packed.columns[1].values<double>() == packed_view->data(), "packing a packed frame copies nothing");
+
+    // Naive product, column by column, of the frames' numeric cells
+    const auto naive_product = [](const DataFrame& x, const DataFrame& y) {
+        const std::vector<std::size_t> cx = numeric_column_indices(x), cy = numeric_column_indices(y);
+        Eigen::MatrixXd out(x.row_count(), cx.size());
+        for (std::size_t c = 0; c < cx.size(); ++c) {
+            const Eigen::VectorXd a = extract_numeric_column(x.columns[cx[c]]);
+            const Eigen::VectorXd b = extract_numeric_column(y.columns[cy[c]]);
+            for (Eigen::Index row = 0; row < a.size(); ++row) out(row, static_cast<Eigen::Index>(c)) = a[row] * b[row];
+        }
+        return out;
+    };
+    const auto same_matrix = [](const Eigen::MatrixXd& a, const Eigen::MatrixXd& b) {
+        if (a.rows() != b.rows() || a.cols() != b.cols()) return false;
+        for (Eigen::Index i = 0; i < a.size(); ++i) {
+            if (!same_number(a.data()[i], b.data()[i])) return false;
+        }
+        return true;
+    };
+    check(same_matrix(elementwise_multiply(block, block), naive_product(block, block)),
+          "block product matches a naive loop");
+    check(same_matrix(elementwise_multiply(block, loose), naive_product(block, loose)),
+          "mixed product matches a naive loop");
+}
+
+// Rows for the expression tests: two whole tasks, three whole chunks and
+// a partial one, so no boundary lines up with the end of the data
+constexpr std::size_t expression_rows = 2 * expr_chunk_rows * expr_chunks_per_task + 3 * expr_chunk_rows + 37;
+
+// Expressions evaluate, reduce and filter as a naive loop over the rows
+// does, with nulls propagated and int64 arithmetic wrapping around
+void test_expressions() {
+    const std::size_t rows = expression_rows;
+    const char* names[] = {"red", "green", "blue"};
+    std::mt19937_64 rng(21);
+    std::vector<std::optional<std::int64_t>> a(rows);
+    std::vector<std::optional<double>> x(rows), y(rows);
+    std::vector<std::optional<std::string>> s(rows);
+    ColumnBuilder ab(ColumnType::int64, rows), xb(ColumnType::float64, rows), yb(ColumnType::float64, rows),
+        sb(ColumnType::string, rows);
+    for (std::size_t row = 0; row < rows; ++row) {
+        // Some values near the int64 limits, so products wrap around
+        if (rng() % 13 != 0) a[row] = rng() % 50 == 0 ? static_cast<std::int64_t>(rng()) : static_cast<std::int64_t>(rng() % 100) - 50;
+        if (rng() % 11 != 0) x[row] = static_cast<double>(rng() % 4096) / 64.0 - 32.0;
+        // NaN, infinity and out-of-range values for casts
+        const double special[] = {std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::infinity(),
+                                  -1e19, 9.3e18, -9223372036854775808.0, 1e18 + 0.5};
+        if (rng() % 9 != 0) y[row] = rng() % 5 == 0 ? special[rng() % 6] : static_cast<double>(rng() % 2001) / 8.0 - 125.0;
+        if (rng() % 7 != 0) s[row] = names[rng() % 3];
+        if (a[row]) ab.append_int64(*a[row]);
+        else ab.append_null();
+        if (x[row]) xb.append_double(*x[row]);
+        else xb.append_null();
+        if (y[row]) yb.append_double(*y[row]);
+        else yb.append_null();
+        if (s[row]) sb.append_string(*s[row]);
+        else sb.append_null();
+    }
+    DataFrame df;
+    add_column(df, "a", ab.finish());
+    add_column(df, "x", xb.finish());
+    add_column(df, "y", yb.finish());
+    add_column(df, "s", encode_dictionary(sb.finish()));
+    // Same dictionary as s, rows reversed: compares code with code
+    std::vector<std::size_t> reversed(rows);
+    for (std::size_t row = 0; row < rows; ++row) reversed[row] = rows - 1 - row;
+    add_column(df, "t", take(df.columns[3], reversed));
+    check(df.columns[4].dictionary() == df.columns[3].dictionary(), "taken dictionary column shares the dictionary");
+
+    const auto wrap = [](std::int64_t p, std::int64_t q, std::int64_t r) {
+        return static_cast<std::int64_t>(static_cast<std::uint64_t>(p) * static_cast<std::uint64_t>(q) +
+                                         static_cast<std::uint64_t>(r));
+    };
+    for (unsigned threads : {1u, 4u}) {
+        const std::string on = " on " + std::to_string(threads) + " threads";
+
+        const Column wrapped = (df["a"] * df["a"] + 7).evaluate(threads);
+        bool same = wrapped.type() == ColumnType::int64;
+        for (std::size_t row = 0; same && row < rows; ++row) {
+            same = a[row] ? !wrapped.is_null(row) && wrapped.values<std::int64_t>()[row] == wrap(*a[row], *a[row], 7)
+                          : wrapped.is_null(row);
+        }
+        check(same, "int64 arithmetic wraps around and keeps nulls" + on);
+
+        const Column mixed = ((df["x"] - df["a"]) / 2.0).evaluate(threads);
+        same = mixed.type() == ColumnType::float64;
+        for (std::size_t row = 0; same && row < rows; ++row) {
+            same = a[row] && x[row] ? !mixed.is_null(row) &&
+                                          mixed.values<double>()[row] == (*x[row] - static_cast<double>(*a[row])) / 2.0
+                                    : mixed.is_null(row);
+        }
+        check(same, "a null in either operand makes the row null" + on);
+
+        const Column truncated = df["y"].cast(ColumnType::int64).evaluate(threads);
+        same = true;
+        for (std::size_t row = 0; same && row < rows; ++row) {
+            const bool fits = y[row] && std::fabs(*y[row]) < 9223372036854775808.0;
+            same = fits ? !truncated.is_null(row) && truncated.values<std::int64_t>()[row] == static_cast<std::int64_t>(*y[row])
+                        : truncated.is_null(row);
+        }
+        check(same, "cast to int64 truncates, and NaN or overflow becomes null" + on);
+        // Null int64 cells hold 0, so the cast must keep their nulls itself
+        const Column halves = (df["a"] * 0.5).cast(ColumnType::int64).evaluate(threads);
+        same = true;
+        for (std::size_t row = 0; same && row < rows; ++row) {
+            same = a[row] ? !halves.is_null(row) &&
+                                halves.values<std::int64_t>()[row] == static_cast<std::int64_t>(static_cast<double>(*a[row]) * 0.5)
+                          : halves.is_null(row);
+        }
+        check(same, "cast keeps the nulls of its operand" + on);
+
+        const Column filled = df["a"].fill_null(-1).evaluate(threads);
+        const Column either = df["x"].fill_null(df["a"]).evaluate(threads);
+        same = filled.null_count() == 0;
+        for (std::size_t row = 0; same && row < rows; ++row) {
+            same = filled.values<std::int64_t>()[row] == a[row].value_or(-1) &&
+                   (x[row] || a[row] ? !either.is_null(row) &&
+                                           either.values<double>()[row] == (x[row] ? *x[row] : static_cast<double>(*a[row]))
+                                     : either.is_null(row));
+        }
+        check(same, "fill_null takes the fill value only where the row is null" + on);
+
+        const ExprSummary summary = (df["x"] * df["a"]).summarize(threads);
+        ExprSummary naive;
+        for (std::size_t row = 0; row < rows; ++row) {
+            if (!x[row] || !a[row]) continue;
+            const double v = *x[row] * static_cast<double>(*a[row]);
+            ++naive.count;
+            naive.sum += v;
+            naive.min = std::min(naive.min, v);
+            naive.max = std::max(naive.max, v);
+        }
+        check(summary.count == naive.count && summary.min == naive.min && summary.max == naive.max &&
+                  std::fabs(summary.sum - naive.sum) <= 1e-9 * std::max(1.0, std::fabs(naive.sum)),
+              "summarize matches a naive reduction" + on);
+
+        const Expr predicate = ((df["a"] > 10) & !(df["x"] >= 0.5)) | df["y"].is_null();
+        std::vector<std::size_t> expected;
+        for (std::size_t row = 0; row < rows; ++row) {
+            const bool left = a[row] && x[row] && *a[row] > 10 && !(*x[row] >= 0.5);
+            // A null operand makes the whole row null, and null is not true
+            if (a[row] && x[row] && (left || !y[row])) expected.push_back(row);
+        }
+        check(matching_rows(predicate, threads) == expected, "matching_rows matches a naive loop" + on);
+        const DataFrame kept = filter(df, predicate, threads);
+        same = kept.row_count() == expected.size();
+        for (std::size_t k = 0; same && k < expected.size(); ++k) {
+            same = key_value(kept.columns[0], k) == key_value(df.columns[0], expected[k]) &&
+                   key_value(kept.columns[3], k) == key_value(df.columns[3], expected[k]);
+        }
+        check(same, "filter keeps the matching rows in order" + on);
+
+        // Dictionary codes against a literal, a missing value and a column
+        // sharing the dictionary
+        const auto text_rows = [&](const std::function<bool(std::size_t)>& match) {
+            std::vector<std::size_t> found;
+            for (std::size_t row = 0; row < rows; ++row) {
+                if (match(row)) found.push_back(row);
+            }
+            return found;
+        };
+        check(matching_rows(df["s"] == "green", threads) == text_rows([&](std::size_t r) { return s[r] == "green"; }),
+              "dictionary column equals a literal" + on);
+        check(matching_rows(df["s"] != "purple", threads) == text_rows([&](std::size_t r) { return s[r].has_value(); }),
+              "value missing from the dictionary matches no row" + on);
+        check(matching_rows(df["s"] == df["t"], threads) ==
+                  text_rows([&](std::size_t r) { return s[r] && s[rows - 1 - r] && *s[r] == *s[rows - 1 - r]; }),
+              "dictionary columns sharing a dictionary compare codes" + on);
+        check(matching_rows(df["s"].is_null(), threads) == text_rows([&](std::size_t r) { return !s[r]; }),
+              "is_null finds the null rows" + on);
+    }
+}
+
+// A CSV file read in many small batches holds the same cells as one read
+void test_csv_batches(const std::string& dir) {
+    const std::string path = dir + "/batches.csv";
+    std::string csv = "id,x,name,flag\n";
+    for (int row = 0; row < 2000; ++row) {
+        csv += std::to_string(row) + ",";
+        if (row % 7 != 0) csv += std::to_string(row * 0.25 + 0.125);
+        csv += ",";
+        csv += row % 5 == 0 ? "" : row % 3 == 0 ? "\"comma, \"\"quoted\"\" " + std::to_string(row) + "\""
+                                                : "plain" + std::to_string(row % 11);
+        csv += ",";
+        csv += "YNM"[row % 3];
+        csv += row % 2 == 0 ? "\n" : "\r\n";
+    }
+    write_file(path, csv);
+
+    const DataFrame whole = read_csv(path);
+    check(whole.row_count() == 2000, "CSV row count");
+    check(whole.columns[2].string_at(3) == "comma, \"quoted\" 3", "quoted CSV field with a comma and quotes");
+    check(whole.columns[1].is_null(0) && whole.columns[2].is_null(0), "empty CSV fields are nulls");
+
+    CsvOptions options;
+    options.batch_bytes = 4096;
+    options.threads = 4;
+    CsvReader reader(path, options);
+    std::size_t batches = 0, row = 0;
+    bool same = true;
+    while (auto batch = reader.next_batch()) {
+        ++batches;
+        same = same && batch->column_names == whole.column_names;
+        for (std::size_t r = 0; same && r < batch->row_count(); ++r, ++row) {
+            for (std::size_t c = 0; c < whole.columns.size(); ++c) {
+                same = same && key_value(batch->columns[c], r) == key_value(whole.columns[c], row);
+            }
+        }
+    }
+    check(batches > 4, "small batch size splits the file");
+    check(same && row == whole.row_count(), "CSV batches hold the cells of a single read");
+}
+
+// A key column read as int64 in early batches and widened to string by a
+// later one groups the numbers by their text, as one read of the file does
+void test_group_csv_widening(const std::string& dir) {
+    const std::string path = dir + "/widening.csv";
+    std::string csv = "k,v\n";
+    std::map<std::string, std::pair<std::int64_t, double>> expected;
+    for (int row = 0; row < 3000; ++row) {
+        const std::string key = row > 2500 && row % 4 == 0 ? "key" + std::to_string(row % 3) : std::to_string(row % 37);
+        csv += key + "," + std::to_string(row % 11) + "\n";
+        ++expected[key].first;
+        expected[key].second += row % 11;
+    }
+    write_file(path, csv);
+
+    CsvOptions options;
+    options.batch_bytes = 2048;
+    options.threads = 4;
+    CsvReader reader(path, options);
+    GroupBy grouping({"k"}, {{"v", Aggregate::count, ""}, {"v", Aggregate::sum, ""}}, 4);
+    std::size_t batches = 0;
+    bool widened = false;
+    while (auto batch = reader.next_batch()) {
+        widened = widened || (batches > 0 && batch->columns[0].type() == ColumnType::string);
+        ++batches;
+        grouping.add(*batch);
+    }
+    check(widened && batches > 4, "key column widens to string in a later batch");
+    const DataFrame result = grouping.result();
+    check(result.columns[0].type() == ColumnType::string && result.row_count() == expected.size(),
+          "widened key column groups as text");
+    bool same = true;
+    for (std::size_t row = 0; same && row < result.row_count(); ++row) {
+        const auto it = expected.find(std::string(result.columns[0].string_at(row)));
+        same = it != expected.end() && result.columns[1].values<std::int64_t>()[row] == it->second.first &&
+               result.columns[2].values<double>()[row] == it->second.second;
+    }
+    check(same, "groups across the widening match a naive count and sum");
+    check(same_frame(result, group_by(read_csv(path), {"k"}, {{"v", Aggregate::count, ""}, {"v", Aggregate::sum, ""}}, 1)),
+          "streamed group-by matches a group-by of one read");
+}
+
+DataFrame mixed_frame() {
+    DataFrame df;
+    const std::size_t rows = 300;
+    DataFrameColumn ints(rows, std::monostate{}), reals(rows), chars(rows), strings(rows, std::monostate{}),
+        categories(rows, std::monostate{});
+    for (std::size_t row = 0; row < rows; ++row) {
+        const int n = static_cast<int>(row);
+        if (row % 9 != 0) ints[row] = n * 1000 - 7;
+        reals[row] = n * 0.5 - 3.25;
+        chars[row] = static_cast<char>('a' + row % 26);
+        if (row % 4 != 0) strings[row] = "value " + std::to_string(row);
+        if (row % 10 != 0) categories[row] = std::string(row % 3 == 0 ? "low" : "high");
+    }
+    add_column(df, "i", ints);
+    add_column(df, "x", reals);
+    add_column(df, "c", chars);
+    add_column(df, "s", strings);
+    add_categorical_column(df, "cat", categories);
+    return df;
+}
+
+// A frame written to a column file reads back unchanged, compressed or not
+void test_column_file_round_trip(const std::string& dir) {
+    const DataFrame df = mixed_frame();
+    for (bool compress : {false, true}) {
+        const std::string path = dir + (compress ? "/compressed.dfc" : "/plain.dfc");
+        write_column_file(df, path, ColumnFileOptions{compress});
+        const ColumnFile file(path);
+        check(same_frame(file.frame(), df), std::string("column file round trip") + (compress ? " (compressed)" : ""));
+        const ColumnStats& stats = file.stats(0);
+        check(stats.present && stats.int_min == 993 && stats.int_max == 298993, "int64 column stats skip nulls");
+    }
+}
+
+bool open_fails(const std::string& path) {
+    try {
+        ColumnFile file(path);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// Opens, then reads every cell (and hashes the dictionary column as a
+// group-by key); false if the file opened and read cleanly
+bool read_fails(const std::string& path) {
+    try {
+        const ColumnFile file(path);
+        const DataFrame& df = file.frame();
+        for (const Column& column : df.columns) {
+            for (std::size_t row = 0; row < column.size(); ++row) key_value(column, row);
+        }
+        group_by(df, {"d"}, {{"d", Aggregate::count, ""}}, 1);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// Damaged column files are rejected when opened or when the damaged rows
+// are read, never read out of bounds
+void test_corrupt_column_files(const std::string& dir) {
+    const std::string good = dir + "/good.dfc", bad = dir + "/bad.dfc";
+    DataFrame df;
+    add_column(df, "s", DataFrameColumn{std::string("alpha"), std::string("b"), std::monostate{}, std::string("ccc")});
+    add_categorical_column(df, "d", DataFrameColumn{std::string("x"), std::string("y"), std::monostate{},
+                                                    std::string("x")});
+    write_column_file(df, good);
+    const std::string bytes = read_file(good);
+    check(!read_fails(good), "intact column file opens and reads");
+
+    const std::uint64_t offsets[4] = {0, 5, 6, 6};
+    const std::size_t offsets_at = bytes.find(std::string(reinterpret_cast<const char*>(offsets), sizeof offsets));
+    const std::int32_t codes[2] = {0, 1};
+    const std::size_t codes_at = bytes.find(std::string(reinterpret_cast<const char*>(codes), sizeof codes));
+    check(offsets_at != std::string::npos && codes_at != std::string::npos, "buffers found in the column file");
+    if (offsets_at == std::string::npos || codes_at == std::string::npos) return;
+
+    auto damaged = [&](std::size_t at, auto value) {
+        std::string copy = bytes;
+        std::memcpy(&copy[at], &value, sizeof value);
+        write_file(bad, copy);
+        return bad;
+    };
+    // Checks that take constant time run on open...
+    check(open_fails(damaged(offsets_at, std::uint64_t(3))), "first string offset not zero");
+    check(open_fails(damaged(offsets_at + 32, std::uint64_t(1000))), "last string offset past the values");
+    // ...the rest as rows are read, so opening does not page in the columns
+    check(!open_fails(damaged(offsets_at + 8, std::uint64_t(1000))), "inner offsets are not scanned on open");
+    check(read_fails(bad), "string offset past the values");
+    check(read_fails(damaged(offsets_at + 16, std::uint64_t(4))), "decreasing string offsets");
+    check(read_fails(damaged(codes_at + 4, std::int32_t(2))), "dictionary code past the dictionary");
+    check(read_fails(damaged(codes_at, std::int32_t(-1))), "null code in a valid row");
+
+    // The directory entry pointing at the offsets buffer, moved off its boundary
+    std::uint64_t directory;
+    std::memcpy(&directory, &bytes[24], sizeof directory);
+    std::size_t entry = std::string::npos;
+    for (std::size_t p = directory; p + 8 <= bytes.size(); ++p) {
+        std::uint64_t v;
+        std::memcpy(&v, &bytes[p], sizeof v);
+        if (v == offsets_at) {
+            entry = p;
+            break;
+        }
+    }
+    check(entry != std::string::npos && open_fails(damaged(entry, std::uint64_t(offsets_at + 8))), "misaligned buffer");
+
+    write_file(bad, bytes.substr(0, bytes.size() - 10));
+    check(open_fails(bad), "truncated column file");
+    write_file(bad, "NOTCOLS1" + bytes.substr(8));
+    check(open_fails(bad), "bad magic");
+}
+
+// Cells of several kinds make a string column, numbers formatted as text
+void test_mixed_elements() {
+    const Column c = Column::from_elements(DataFrameColumn{1, 2.5, 'z', std::string("text"), std::monostate{}});
+    check(c.type() == ColumnType::string, "mixed cells give a string column");
+    check(c.string_at(0) == "1" && c.string_at(1) == "2.5" && c.string_at(2) == "z" && c.string_at(3) == "text" &&
+              c.is_null(4),
+          "mixed cells formatted as text");
+    check(Column::from_elements(DataFrameColumn{1, 2.5}).type() == ColumnType::float64, "ints and doubles widen");
+    const Column pi = Column::from_elements(DataFrameColumn{1, 3.141592653589793, std::string("a"), 1e300, -0.1});
+    check(pi.string_at(1) == "3.141592653589793" && pi.string_at(3) == "1e+300" && pi.string_at(4) == "-0.1",
+          "numbers in mixed columns keep every digit");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::string dir = argc > 1 ? argv[1] : ".";
+    try {
+        test_joins();
+        test_group_by();
+        test_numeric_views();
+        test_csv_batches(dir);
+        test_expressions();
+        test_group_csv_widening(dir);
+        test_column_file_round_trip(dir);
+        test_corrupt_column_files(dir);
+        test_mixed_elements();
+    } catch (const std::exception& e) {
+        check(false, std::string("unexpected exception: ") + e.what());
+    }
+    std::cout << (failures == 0 ? "All DataFrame tests passed\n" : "DataFrame tests failed\n");
+    return failures == 0 ? 0 : 1;
+}